@@ -0,0 +1,116 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator that owns everything in a scene (materials, primitives, lists, transforms).
+// Objects are placed back to back in large blocks and are all destroyed at once by reset().
+class Arena
+{
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<char[]> memory;
+        size_t size;
+    };
+
+    // destructors of non trivial objects, stored inside the arena itself
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+        Destructor* next;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;     // block we are bumping in
+    size_t offset = 0;      // first free byte in that block
+    Destructor* destructors = nullptr;
+
+    size_t allocations = 0;
+    size_t bytesUsed = 0;
+
+public:
+    Arena() {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() { reset(); }
+
+    void* allocate(size_t bytes, size_t alignment) {
+        while (true) {
+            if (current < blocks.size()) {
+                auto base = reinterpret_cast<uintptr_t>(blocks[current].memory.get());
+                size_t aligned = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+
+                if (aligned + bytes <= blocks[current].size) {
+                    offset = aligned + bytes;
+                    allocations++;
+                    bytesUsed += bytes;
+                    return blocks[current].memory.get() + aligned;
+                }
+
+                // does not fit, move on to the next (possibly recycled) block
+                current++;
+                offset = 0;
+                continue;
+            }
+
+            size_t size = std::max(BLOCK_SIZE, bytes + alignment);
+            blocks.push_back({ std::unique_ptr<char[]>(new char[size]), size });
+        }
+    }
+
+    template<class T, class... Args>
+    T* make(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+        if (!std::is_trivially_destructible<T>::value) {
+            auto d = new (allocate(sizeof(Destructor), alignof(Destructor))) Destructor;
+            d->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+            d->object = object;
+            d->next = destructors;
+            destructors = d;
+        }
+
+        return object;
+    }
+
+    // n value initialized objects back to back, for types that need no destructor
+    template<class T>
+    T* makeArray(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "makeArray does not run destructors");
+        T* objects = static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+        for (size_t i = 0; i < n; i++)
+            new (objects + i) T();
+        return objects;
+    }
+
+    // Destroys every object in reverse order of creation, the blocks are kept for the next scene
+    void reset() {
+        for (auto d = destructors; d != nullptr; d = d->next)
+            d->destroy(d->object);
+
+        destructors = nullptr;
+        current = 0;
+        offset = 0;
+        allocations = 0;
+        bytesUsed = 0;
+    }
+
+    size_t allocationCount() const { return allocations; }
+    size_t bytesAllocated() const { return bytesUsed; }
+    size_t bytesReserved() const {
+        size_t total = 0;
+        for (const auto& block : blocks)
+            total += block.size;
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,550 @@
+// Native benchmarks for the tracer kernels and acceleration structures, not part of the wasm build.
+//
+//   g++ -O3 -std=c++20 -I. bench.cpp -o bench
+//   ./bench                 run everything
+//   ./bench triangles       only the named benchmark (kernels, triangles, bvh, animation, scenes)
+//
+// Run from the repository root, meshes are loaded from assets/.
+
+#include "common.h"
+#include "hittable.h"
+#include "material.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////// TIMING
+
+struct Timing {
+    double median; // seconds
+    double min;
+    double max;
+    double stddev;
+};
+
+// Runs f once to warm up, then `runs` times and reports the spread
+template<class F>
+Timing measure(int runs, F f) {
+    f();
+
+    std::vector<double> seconds;
+    for (int i = 0; i < runs; i++) {
+        auto start = Clock::now();
+        f();
+        seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    double mean = 0, variance = 0;
+    for (double s : seconds)
+        mean += s / runs;
+    for (double s : seconds)
+        variance += (s - mean) * (s - mean) / std::max(runs - 1, 1);
+
+    std::sort(seconds.begin(), seconds.end());
+    return { seconds[seconds.size() / 2], seconds.front(), seconds.back(), sqrt(variance) };
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////// MESHES
+
+struct MeshTriangle {
+    vec3 p0, p1, p2;
+};
+
+// Same subset of the obj format obj_to_code.py understands: v lines and triangular f lines
+std::vector<MeshTriangle> loadObj(const std::string& path) {
+    std::ifstream file(path);
+    std::vector<vec3> vertices;
+    std::vector<MeshTriangle> triangles;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string type;
+        in >> type;
+
+        if (type == "v") {
+            vec3 v;
+            in >> v.x >> v.y >> v.z;
+            vertices.push_back(v);
+        } else if (type == "f") {
+            int a, b, c;
+            in >> a >> b >> c;
+            triangles.push_back({ vertices[a-1], vertices[b-1], vertices[c-1] });
+        }
+    }
+
+    return triangles;
+}
+
+// Rays from a sphere around the mesh aimed at random points inside its bounds
+std::vector<Ray> raysAt(const std::vector<MeshTriangle>& mesh, int count) {
+    vec3 lo(1e30f), hi(-1e30f);
+    for (const auto& tri : mesh) {
+        for (const vec3& p : { tri.p0, tri.p1, tri.p2 }) {
+            lo = vec3(fmin(lo.x, p.x), fmin(lo.y, p.y), fmin(lo.z, p.z));
+            hi = vec3(fmax(hi.x, p.x), fmax(hi.y, p.y), fmax(hi.z, p.z));
+        }
+    }
+
+    vec3 center = 0.5f * (lo + hi);
+    float radius = (hi - lo).length() * 2;
+
+    std::vector<Ray> rays;
+    for (int i = 0; i < count; i++) {
+        vec3 origin = center + radius * MATH::randomUnitVector();
+        vec3 target = lo + (hi - lo) * MATH::randomVec3();
+        rays.push_back(Ray(origin, target - origin));
+    }
+
+    return rays;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////// KERNELS
+
+#define KERNEL_RUNS 15
+#define KERNEL_COUNT (1 << 18) // rays/vectors/hits per run
+
+// The compiler may not drop a kernel whose results are never used
+static volatile float g_sink;
+
+// ns per call of a kernel that is run `count` times per f()
+template<class F>
+void benchLoop(const char* name, size_t count, F f) {
+    float sink = 0;
+    auto timing = measure(KERNEL_RUNS, [&]() { sink += f(); });
+    g_sink = sink;
+
+    printf("  %-26s %7.2f ns  (min %.2f, max %.2f, stddev %4.1f%%)\n", name, timing.median / count * 1e9,
+           timing.min / count * 1e9, timing.max / count * 1e9, 100.0 * timing.stddev / timing.median);
+}
+
+// Rays from a sphere of radius 4 aimed at random points of the [-1, 1] cube, about half of them
+// hit the unit sized shapes at the origin
+std::vector<Ray> randomRays(size_t count) {
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < count; i++) {
+        vec3 origin = 4 * MATH::randomUnitVector();
+        vec3 target = MATH::randomVec3(-1, 1);
+        rays.push_back(Ray(origin, target - origin));
+    }
+    return rays;
+}
+
+// Closest hits of the rays on one hittable, through the virtual interface like the renderer calls it
+float traceAll(const Hittable& hittable, const std::vector<Ray>& rays) {
+    float sum = 0;
+    for (const Ray& r : rays) {
+        hit rec;
+        if (hittable.trace(r, 0.001f, INFINITY, rec))
+            sum += rec.t;
+    }
+    return sum;
+}
+
+void benchKernels() {
+    printf("kernels: %d items per run, %d runs after a warmup, median ns per item\n", KERNEL_COUNT, KERNEL_RUNS);
+
+    std::vector<vec3> a, b;
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        a.push_back(MATH::randomVec3(-1, 1));
+        b.push_back(MATH::randomVec3(-1, 1));
+    }
+
+    auto reduce = [&](auto op) {
+        return [&, op]() {
+            vec3 sum;
+            for (size_t i = 0; i < a.size(); i++)
+                sum += op(a[i], b[i]);
+            return sum.x + sum.y + sum.z;
+        };
+    };
+
+    benchLoop("vec3 +", a.size(), reduce([](const vec3& x, const vec3& y) { return x + y; }));
+    benchLoop("vec3 *", a.size(), reduce([](const vec3& x, const vec3& y) { return x * y; }));
+    benchLoop("vec3 * float", a.size(), reduce([](const vec3& x, const vec3& y) { return x * y.x; }));
+    benchLoop("dot", a.size(), reduce([](const vec3& x, const vec3& y) { return vec3(dot(x, y), 0, 0); }));
+    benchLoop("cross", a.size(), reduce([](const vec3& x, const vec3& y) { return cross(x, y); }));
+    benchLoop("unitVector", a.size(), reduce([](const vec3& x, const vec3&) { return unitVector(x); }));
+    benchLoop("MATH::randomUnitVector", a.size(), [&]() {
+        vec3 sum;
+        for (size_t i = 0; i < a.size(); i++)
+            sum += MATH::randomUnitVector();
+        return sum.x + sum.y + sum.z;
+    });
+
+    auto rays = randomRays(KERNEL_COUNT);
+    Lambertian gray(color(0.5, 0.5, 0.5));
+
+    Sphere sphere(vec3(0,0,0), 1, &gray);
+    Triangle triangle(vec3(-1,-1,0), vec3(1,-1,0), vec3(0,1,0), &gray);
+    RectXY rect(vec3(0,0,0), 1, 1, &gray);
+    Quad quad(vec3(-1,-1,0), vec3(1,-1,0), vec3(1,1,0), vec3(-1,1,0), &gray);
+    Translate translate(&sphere, vec3(0.1, 0.2, 0.3));
+    RotateZ rotate(&sphere, 30);
+    RotateZ rotateTranslate(&translate, 30);
+
+    benchLoop("Sphere::trace", rays.size(), [&]() { return traceAll(sphere, rays); });
+    benchLoop("Triangle::trace", rays.size(), [&]() { return traceAll(triangle, rays); });
+    benchLoop("RectXY::trace", rays.size(), [&]() { return traceAll(rect, rays); });
+    benchLoop("Quad::trace", rays.size(), [&]() { return traceAll(quad, rays); });
+    benchLoop("Translate(Sphere)", rays.size(), [&]() { return traceAll(translate, rays); });
+    benchLoop("RotateZ(Sphere)", rays.size(), [&]() { return traceAll(rotate, rays); });
+    benchLoop("RotateZ(Translate(Sphere))", rays.size(), [&]() { return traceAll(rotateTranslate, rays); });
+
+    // sphere hits with their point and normal, the input of every scatter
+    std::vector<std::pair<Ray, hit>> hits;
+    for (const Ray& r : rays) {
+        hit rec;
+        if (sphere.trace(r, 0.001f, INFINITY, rec)) {
+            evaluateHit(r, rec);
+            hits.push_back({ r, rec });
+        }
+    }
+
+    Unlit unlit(color(0.5, 0.5, 0.5));
+    Metal metal(vec3(0.8, 0.8, 0.8), 0.3);
+    Light light(vec3(4, 4, 4));
+    Dielectric glass(1.5);
+    Special special(vec3(1.0, 0.95, 0.05));
+
+    auto scatterAll = [&](const Material& material) {
+        return [&]() {
+            Sampler sampler;
+            float sum = 0;
+            for (size_t i = 0; i < hits.size(); i++) {
+                sampler.startPixel(int(i & 255), int(i >> 8), 0);
+                sampler.startBounce();
+
+                vec3 attenuation;
+                Ray scattered;
+                if (material.scatter(hits[i].first, hits[i].second, attenuation, scattered, sampler))
+                    sum += scattered.direction.x + attenuation.x;
+            }
+            return sum;
+        };
+    };
+
+    benchLoop("Unlit::scatter", hits.size(), scatterAll(unlit));
+    benchLoop("Lambertian::scatter", hits.size(), scatterAll(gray));
+    benchLoop("Metal::scatter", hits.size(), scatterAll(metal));
+    benchLoop("Light::scatter", hits.size(), scatterAll(light));
+    benchLoop("Dielectric::scatter", hits.size(), scatterAll(glass));
+    benchLoop("Special::scatter", hits.size(), scatterAll(special));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////// TRIANGLES
+
+struct KernelResult {
+    double raysPerSecond;
+    std::vector<int> closest; // closest triangle per ray, -1 on a miss
+};
+
+template<class Kernel>
+KernelResult benchKernel(const char* name, const std::vector<MeshTriangle>& mesh, const std::vector<Ray>& rays) {
+    std::vector<Kernel> kernels;
+    for (const auto& tri : mesh)
+        kernels.push_back(Kernel(tri.p0, tri.p1, tri.p2));
+
+    KernelResult result;
+    result.closest.resize(rays.size());
+
+    auto timing = measure(5, [&]() {
+        for (size_t r = 0; r < rays.size(); r++) {
+            float closest = INFINITY;
+            int index = -1;
+
+            for (size_t k = 0; k < kernels.size(); k++) {
+                float t, u, v;
+                if (kernels[k].intersect(rays[r], 0.001f, closest, t, u, v)) {
+                    closest = t;
+                    index = int(k);
+                }
+            }
+
+            result.closest[r] = index;
+        }
+    });
+
+    result.raysPerSecond = rays.size() / timing.median;
+    double tests = double(rays.size()) * kernels.size();
+
+    printf("  %-16s %3zu bytes/tri  %8.2f Mtests/s  (%.2f .. %.2f ms)\n", name, sizeof(Kernel),
+           tests / timing.median / 1e6, timing.min * 1e3, timing.max * 1e3);
+
+    return result;
+}
+
+void benchTriangles() {
+    auto mesh = loadObj("assets/badeend.obj");
+    if (mesh.empty()) {
+        printf("triangles: assets/badeend.obj not found, run from the repository root\n");
+        return;
+    }
+
+    auto rays = raysAt(mesh, 100000);
+    printf("triangles: %zu triangles, %zu rays, brute force closest hit\n", mesh.size(), rays.size());
+
+    auto reference = benchKernel<MollerTrumbore>("MollerTrumbore", mesh, rays);
+    auto baldwinWeber = benchKernel<BaldwinWeber>("BaldwinWeber", mesh, rays);
+    auto woop = benchKernel<Woop>("Woop", mesh, rays);
+
+    // the kernels round differently, edge cases may pick a neighbour triangle
+    auto agreement = [&](const KernelResult& result) {
+        size_t same = 0;
+        for (size_t r = 0; r < rays.size(); r++)
+            same += result.closest[r] == reference.closest[r];
+        return 100.0 * same / rays.size();
+    };
+    printf("  closest hit agreement with MollerTrumbore: BaldwinWeber %.3f%%, Woop %.3f%%\n",
+           agreement(baldwinWeber), agreement(woop));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////// BVH
+
+// Every triangle split in four at its edge midpoints, the same surface with 4x the triangles
+std::vector<MeshTriangle> subdivide(const std::vector<MeshTriangle>& mesh) {
+    std::vector<MeshTriangle> result;
+    for (const auto& tri : mesh) {
+        vec3 a = 0.5f * (tri.p0 + tri.p1), b = 0.5f * (tri.p1 + tri.p2), c = 0.5f * (tri.p2 + tri.p0);
+        result.push_back({ tri.p0, a, c });
+        result.push_back({ a, tri.p1, b });
+        result.push_back({ c, b, tri.p2 });
+        result.push_back({ a, b, c });
+    }
+    return result;
+}
+
+struct TraversalResult {
+    double raysPerSecond;
+    double steps;               // nodes visited per ray
+    double tests;               // triangles tested per ray
+    std::vector<int> closest;
+};
+
+template<class Traverse>
+TraversalResult benchTraversal(const char* name, size_t nodeBytes, size_t triangles, const std::vector<Ray>& rays, Traverse traverse) {
+    TraversalResult result;
+    result.closest.resize(rays.size());
+
+    auto timing = measure(5, [&]() {
+        for (size_t r = 0; r < rays.size(); r++)
+            result.closest[r] = traverse(rays[r]);
+    });
+
+    g_traceCost = TraceCost();
+    for (size_t r = 0; r < rays.size(); r++)
+        traverse(rays[r]);
+
+    result.raysPerSecond = rays.size() / timing.median;
+    result.steps = double(g_traceCost.steps) / rays.size();
+    result.tests = double(g_traceCost.tests) / rays.size();
+
+    printf("  %-10s %8zu node bytes %6.2f bytes/tri %6.1f nodes/ray %6.1f tris/ray %8.2f Mrays/s  (%.2f .. %.2f ms)\n", name,
+           nodeBytes, double(nodeBytes) / triangles, result.steps, result.tests, result.raysPerSecond / 1e6, timing.min * 1e3, timing.max * 1e3);
+
+    return result;
+}
+
+void benchBVH() {
+    auto mesh = loadObj("assets/badeend.obj");
+    if (mesh.empty()) {
+        printf("bvh: assets/badeend.obj not found, run from the repository root\n");
+        return;
+    }
+
+    for (int level = 0; level <= 4; level += 2) {
+        std::vector<AABB> bounds(mesh.size());
+        for (size_t i = 0; i < mesh.size(); i++) {
+            bounds[i].grow(mesh[i].p0);
+            bounds[i].grow(mesh[i].p1);
+            bounds[i].grow(mesh[i].p2);
+        }
+
+        std::vector<BVHNode> nodes(2 * mesh.size());
+        std::vector<uint32_t> order(mesh.size());
+        nodes.resize(buildBVH(bounds.data(), uint32_t(mesh.size()), nodes.data(), order.data()));
+
+        std::vector<QBVHNode> wideNodes(nodes.size());
+        wideNodes.resize(buildQBVH(nodes.data(), wideNodes.data()));
+
+        std::vector<TRIANGLE_KERNEL> triangles;
+        for (uint32_t i : order)
+            triangles.push_back(TRIANGLE_KERNEL(mesh[i].p0, mesh[i].p1, mesh[i].p2));
+
+        auto rays = raysAt(mesh, 200000);
+        printf("bvh: %zu triangles (duck subdivided %d times), %zu rays, closest hit\n", mesh.size(), level, rays.size());
+
+        auto closestHit = [&](const Ray& r, auto&& traverse) {
+            float closest = INFINITY;
+            int index = -1;
+            traverse(r, 0.001f, closest, [&](uint32_t i, float& closest) {
+                float t, u, v;
+                g_traceCost.tests++;
+                if (triangles[i].intersect(r, 0.001f, closest, t, u, v)) {
+                    closest = t;
+                    index = int(i);
+                }
+            });
+            return index;
+        };
+
+        auto binary = benchTraversal("binary", nodes.size() * sizeof(BVHNode), mesh.size(), rays, [&](const Ray& r) {
+            return closestHit(r, [&](auto&&... args) { traverseBVH(nodes.data(), args...); });
+        });
+        auto quantized = benchTraversal("quantized", wideNodes.size() * sizeof(QBVHNode), mesh.size(), rays, [&](const Ray& r) {
+            return closestHit(r, [&](auto&&... args) { traverseQBVH(wideNodes.data(), args...); });
+        });
+
+        size_t same = 0;
+        for (size_t r = 0; r < rays.size(); r++)
+            same += binary.closest[r] == quantized.closest[r];
+        printf("  closest hit agreement %.3f%%, quantized is %.2fx the speed in %.0f%% of the memory\n", 100.0 * same / rays.size(),
+               quantized.raysPerSecond / binary.raysPerSecond, 100.0 * wideNodes.size() * sizeof(QBVHNode) / (nodes.size() * sizeof(BVHNode)));
+
+        mesh = subdivide(subdivide(mesh));
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////// ANIMATION
+
+// A duck that turns and bobs: the cost of a refit against a rebuild per frame, and what the refitted
+// BVH costs the rays compared to one built for the pose
+void benchAnimation() {
+    Lambertian gray(color(0.5, 0.5, 0.5));
+    BadEend eend(&gray, &gray);
+    AnimatedMesh duck(eend);
+
+    auto poseAt = [](int frame) {
+        float radians = MATH::degreesToRadians(frame * 2.0f);
+        return TransformZ().rotated(cos(radians), sin(radians)).translated(vec3(0, 0, 0.2f * sin(frame * 0.1f)));
+    };
+
+    auto rays = randomRays(KERNEL_COUNT);
+    const int frames = 180;
+    printf("animation: duck turning 2 degrees per frame, %d frames, %zu rays per pose\n", frames, rays.size());
+
+    int frame = 0;
+    auto refit = measure(frames - 1, [&]() { duck.setPose(poseAt(frame++)); });
+    int triggered = duck.rebuilds - 1;
+    auto rebuild = measure(frames - 1, [&]() { duck.rebuild(); });
+    printf("  setPose %.1f us (%.1f .. %.1f), rebuild %.1f us (%.1f .. %.1f), %d rebuilds in %d poses\n",
+           refit.median * 1e6, refit.min * 1e6, refit.max * 1e6, rebuild.median * 1e6, rebuild.min * 1e6, rebuild.max * 1e6,
+           triggered, duck.refits);
+
+    // refit() never rebuilds, the refitted tree is still the one built for the pose at frame 0
+    for (int turn = 15; turn <= 90; turn += 25) {
+        AnimatedMesh refitted(eend);
+        refitted.refit(poseAt(turn / 2));
+        AnimatedMesh built(eend);
+        built.refit(poseAt(turn / 2));
+        built.rebuild();
+        if (refitted.rebuilds != 1 || built.rebuilds != 2) {
+            printf("  turned %2d degrees: unexpected rebuilds (%d, %d)\n", turn, refitted.rebuilds, built.rebuilds);
+            continue;
+        }
+
+        auto refittedTiming = measure(5, [&]() { g_sink = traceAll(refitted, rays); });
+        auto builtTiming = measure(5, [&]() { g_sink = traceAll(built, rays); });
+        printf("  turned %2d degrees: refitted %.2f Mrays/s (SAH %.2fx), rebuilt %.2f Mrays/s, %.2fx\n", turn,
+               rays.size() / refittedTiming.median / 1e6, refitted.costRatio(), rays.size() / builtTiming.median / 1e6,
+               refittedTiming.median / builtTiming.median);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////// SCENES
+
+// The levels traced through the virtual HittableList the renderer uses and through a StaticScene, and
+// with the ducks behind a Transformed against baked into world space (see MeshT::compile)
+void benchScenes() {
+    HittableList* (*worlds[])(Arena&) = { world1, world2, world3 };
+    const int count = 1 << 16;
+
+    for (int level = 1; level <= 3; level++) {
+        srand48(51);
+        loadWorld(level);
+        Arena arena;
+        srand48(51);
+        StaticScene* typed = compileStaticScene(arena, worlds[level - 1](arena));
+        srand48(51);
+        HittableList* transformed = compileScene(arena, worlds[level - 1](arena), MESH_BAKE_NEVER);
+        srand48(51);
+        HittableList* baked = compileScene(arena, worlds[level - 1](arena), MESH_BAKE_ALWAYS);
+
+        std::vector<Ray> rays;
+        for (int i = 0; i < count; i++)
+            rays.push_back(g_camera.getRay(MATH::random(), MATH::random()));
+
+        printf("scenes: level %d, %d primitives, %d camera rays\n", level, typed->size(), count);
+
+        auto paths = [&](const Hittable& scene, std::vector<vec3>& colors) {
+            colors.resize(rays.size());
+            return measure(5, [&]() {
+                Sampler sampler;
+                for (size_t i = 0; i < rays.size(); i++) {
+                    sampler.startPixel(int(i & 255), int(i >> 8), 0);
+                    colors[i] = trace(rays[i], scene, 4, sampler);
+                }
+            });
+        };
+
+        std::vector<vec3> virtualColors, staticColors;
+        auto virtualPrimary = measure(5, [&]() { g_sink = traceAll(*g_world, rays); });
+        auto staticPrimary = measure(5, [&]() { g_sink = traceAll(*typed, rays); });
+        auto transformedPrimary = measure(5, [&]() { g_sink = traceAll(*transformed, rays); });
+        auto bakedPrimary = measure(5, [&]() { g_sink = traceAll(*baked, rays); });
+        auto virtualPaths = paths(*g_world, virtualColors);
+        auto staticPaths = paths(*typed, staticColors);
+
+        size_t same = 0;
+        for (size_t i = 0; i < rays.size(); i++) {
+            const vec3& a = virtualColors[i];
+            const vec3& b = staticColors[i];
+            same += memcmp(&a, &b, sizeof(vec3)) == 0;
+        }
+
+        printf("  closest hit  virtual %6.2f Mrays/s  static %6.2f Mrays/s  (%.2fx)\n", count / virtualPrimary.median / 1e6,
+               count / staticPrimary.median / 1e6, virtualPrimary.median / staticPrimary.median);
+        printf("  ducks        transformed %6.2f Mrays/s  baked %6.2f Mrays/s  (%.2fx)\n", count / transformedPrimary.median / 1e6,
+               count / bakedPrimary.median / 1e6, transformedPrimary.median / bakedPrimary.median);
+        printf("  paths        virtual %6.2f Mpaths/s  static %6.2f Mpaths/s  (%.2fx), %.3f%% identical colours\n",
+               count / virtualPaths.median / 1e6, count / staticPaths.median / 1e6, virtualPaths.median / staticPaths.median,
+               100.0 * same / rays.size());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////// MAIN
+
+int main(int argc, char** argv) {
+    srand48(51);
+
+    struct Benchmark {
+        const char* name;
+        void (*run)();
+    };
+
+    Benchmark benchmarks[] = {
+        { "kernels", benchKernels },
+        { "triangles", benchTriangles },
+        { "bvh", benchBVH },
+        { "animation", benchAnimation },
+        { "scenes", benchScenes },
+    };
+
+    for (const auto& benchmark : benchmarks) {
+        if (argc > 1 && strcmp(argv[1], benchmark.name) != 0)
+            continue;
+        benchmark.run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,504 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "common.h"
+#include "trace_cost.h"
+
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+// Bounding volume hierarchy over primitives that are only known by their bounding boxes.
+// buildBVH makes a binary tree, buildQBVH collapses it into the compact 4-wide tree meshes are traced
+// with. Both are constexpr: baked meshes run them at compile time, everything else at runtime.
+
+#define BVH_BINS 12        // SAH split candidates per axis
+#define BVH_MAX_LEAF 4     // leaves can be bigger only when their primitives cannot be separated
+#define BVH_STACK_SIZE 64
+
+struct AABB {
+    float lo[3] = {  1e30f,  1e30f,  1e30f };
+    float hi[3] = { -1e30f, -1e30f, -1e30f };
+
+    constexpr void grow(const vec3& p) {
+        const float v[3] = { p.x, p.y, p.z };
+        for (int a = 0; a < 3; a++) {
+            lo[a] = v[a] < lo[a] ? v[a] : lo[a];
+            hi[a] = v[a] > hi[a] ? v[a] : hi[a];
+        }
+    }
+
+    constexpr void grow(const AABB& b) {
+        for (int a = 0; a < 3; a++) {
+            lo[a] = b.lo[a] < lo[a] ? b.lo[a] : lo[a];
+            hi[a] = b.hi[a] > hi[a] ? b.hi[a] : hi[a];
+        }
+    }
+
+    constexpr float area() const {
+        float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        if (dx < 0 || dy < 0 || dz < 0)
+            return 0;
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+
+    constexpr float center(int axis) const {
+        return 0.5f * (lo[axis] + hi[axis]);
+    }
+};
+
+// 32 bytes. Interior nodes (count == 0) have their children at leftFirst and leftFirst + 1,
+// leaves cover primitives [leftFirst, leftFirst + count) of the order written by buildBVH
+struct BVHNode {
+    float lo[3];
+    uint32_t leftFirst;
+    float hi[3];
+    uint32_t count;
+};
+
+// Builds a binned SAH hierarchy. nodes needs room for 2 * count nodes, order receives the primitive
+// index for every leaf slot. Returns the number of nodes used.
+constexpr uint32_t buildBVH(const AABB* bounds, uint32_t count, BVHNode* nodes, uint32_t* order) {
+    for (uint32_t i = 0; i < count; i++)
+        order[i] = i;
+
+    nodes[0] = BVHNode{ {0, 0, 0}, 0, {0, 0, 0}, count };
+    uint32_t nodeCount = 1;
+
+    uint32_t stack[BVH_STACK_SIZE] = {};
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        BVHNode& node = nodes[stack[--stackSize]];
+        uint32_t first = node.leftFirst;
+        uint32_t n = node.count;
+
+        AABB box, centroids;
+        for (uint32_t i = first; i < first + n; i++) {
+            const AABB& b = bounds[order[i]];
+            box.grow(b);
+            centroids.grow(vec3(b.center(0), b.center(1), b.center(2)));
+        }
+        for (int a = 0; a < 3; a++) {
+            node.lo[a] = box.lo[a];
+            node.hi[a] = box.hi[a];
+        }
+
+        if (n <= 1)
+            continue;
+
+        // find the cheapest bin boundary on all three axes
+        int bestAxis = -1;
+        int bestSplit = 0;
+        float bestCost = 1e30f;
+
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centroids.hi[axis] - centroids.lo[axis];
+            if (extent <= 0)
+                continue;
+
+            AABB binBounds[BVH_BINS] = {};
+            uint32_t binCount[BVH_BINS] = {};
+            float scale = BVH_BINS / extent;
+
+            for (uint32_t i = first; i < first + n; i++) {
+                const AABB& b = bounds[order[i]];
+                int bin = int((b.center(axis) - centroids.lo[axis]) * scale);
+                bin = bin < BVH_BINS - 1 ? bin : BVH_BINS - 1;
+                binBounds[bin].grow(b);
+                binCount[bin]++;
+            }
+
+            float rightCost[BVH_BINS] = {};
+            AABB right;
+            uint32_t rightCount = 0;
+            for (int split = BVH_BINS - 1; split > 0; split--) {
+                right.grow(binBounds[split]);
+                rightCount += binCount[split];
+                rightCost[split] = rightCount * right.area();
+            }
+
+            AABB left;
+            uint32_t leftCount = 0;
+            for (int split = 1; split < BVH_BINS; split++) {
+                left.grow(binBounds[split - 1]);
+                leftCount += binCount[split - 1];
+                float cost = leftCount * left.area() + rightCost[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // SAH with traversal and intersection cost 1, both sides scaled by the area of the node
+        float leafCost = n * box.area();
+        bool cheaperAsLeaf = bestCost + box.area() >= leafCost && n <= BVH_MAX_LEAF;
+        if (bestAxis < 0 || cheaperAsLeaf || stackSize + 2 > BVH_STACK_SIZE)
+            continue;
+
+        float scale = BVH_BINS / (centroids.hi[bestAxis] - centroids.lo[bestAxis]);
+        uint32_t i = first;
+        uint32_t j = first + n;
+        while (i < j) {
+            int bin = int((bounds[order[i]].center(bestAxis) - centroids.lo[bestAxis]) * scale);
+            if (bin < bestSplit) {
+                i++;
+            } else {
+                uint32_t swap = order[i];
+                order[i] = order[--j];
+                order[j] = swap;
+            }
+        }
+
+        uint32_t leftCount = i - first;
+        if (leftCount == 0 || leftCount == n)
+            continue;
+
+        uint32_t left = nodeCount++;
+        uint32_t right = nodeCount++;
+        nodes[left] = BVHNode{ {0, 0, 0}, first, {0, 0, 0}, leftCount };
+        nodes[right] = BVHNode{ {0, 0, 0}, first + leftCount, {0, 0, 0}, n - leftCount };
+
+        node.leftFirst = left;
+        node.count = 0;
+
+        stack[stackSize++] = right;
+        stack[stackSize++] = left;
+    }
+
+    return nodeCount;
+}
+
+// Entry distance of the ray into the box of a node, or 1e30f when it misses it within [t_min, t_max]
+inline float intersectBVHNode(const BVHNode& node, const vec3& origin, const vec3& invDirection, float t_min, float t_max) {
+    float tx1 = (node.lo[0] - origin.x) * invDirection.x, tx2 = (node.hi[0] - origin.x) * invDirection.x;
+    float tmin = fmin(tx1, tx2), tmax = fmax(tx1, tx2);
+    float ty1 = (node.lo[1] - origin.y) * invDirection.y, ty2 = (node.hi[1] - origin.y) * invDirection.y;
+    tmin = fmax(tmin, fmin(ty1, ty2)), tmax = fmin(tmax, fmax(ty1, ty2));
+    float tz1 = (node.lo[2] - origin.z) * invDirection.z, tz2 = (node.hi[2] - origin.z) * invDirection.z;
+    tmin = fmax(tmin, fmin(tz1, tz2)), tmax = fmin(tmax, fmax(tz1, tz2));
+
+    if (tmax >= tmin && tmax >= t_min && tmin <= t_max)
+        return tmin;
+    return 1e30f;
+}
+
+// Visits the leaves the ray can reach, closest child first. intersect(i, closest) tests leaf slot i
+// and lowers closest when it found a closer hit.
+template<class Intersect>
+inline void traverseBVH(const BVHNode* nodes, const Ray& r, float t_min, float& closest, Intersect&& intersect) {
+    vec3 invDirection(1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z);
+
+    if (intersectBVHNode(nodes[0], r.origin, invDirection, t_min, closest) == 1e30f) {
+        g_traceCost.steps++;
+        return;
+    }
+
+    const BVHNode* stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    const BVHNode* node = &nodes[0];
+
+    while (true) {
+        g_traceCost.steps++;
+
+        if (node->count > 0) {
+            for (uint32_t i = 0; i < node->count; i++)
+                intersect(node->leftFirst + i, closest);
+
+            if (stackSize == 0)
+                return;
+            node = stack[--stackSize];
+            continue;
+        }
+
+        const BVHNode* near = &nodes[node->leftFirst];
+        const BVHNode* far = &nodes[node->leftFirst + 1];
+        float dNear = intersectBVHNode(*near, r.origin, invDirection, t_min, closest);
+        float dFar = intersectBVHNode(*far, r.origin, invDirection, t_min, closest);
+
+        if (dFar < dNear) {
+            std::swap(near, far);
+            std::swap(dNear, dFar);
+        }
+
+        if (dNear == 1e30f) {
+            if (stackSize == 0)
+                return;
+            node = stack[--stackSize];
+        } else {
+            node = near;
+            if (dFar != 1e30f)
+                stack[stackSize++] = far;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////// QUANTIZED
+
+#define QBVH_WIDTH 4
+#define QBVH_EMPTY 0xffffffffu
+
+// Node of a 4-wide tree in one cache line. The boxes of the children are stored in 8 bits per plane on
+// a grid over the box of the node: lo = origin + qlo * 2^exponent. The three binary nodes it replaces
+// take 96 bytes.
+struct alignas(64) QBVHNode {
+    float origin[3];
+    int8_t exponent[3];
+    uint8_t qlo[3][QBVH_WIDTH];     // per axis, per child
+    uint8_t qhi[3][QBVH_WIDTH];
+    uint32_t child[QBVH_WIDTH];     // node index, first primitive of a leaf or QBVH_EMPTY
+    uint16_t count[QBVH_WIDTH];     // primitives of a leaf, 0 for a node
+};
+
+constexpr float powerOfTwo(int exponent) {
+    return std::bit_cast<float>(uint32_t(exponent + 127) << 23);
+}
+
+// Fills the grid of a node with the boxes of its children (BVHNodes or AABBs), rounded outwards
+template<class Box>
+constexpr void quantizeChildren(QBVHNode& node, const Box* const* children, int count) {
+    for (int a = 0; a < 3; a++) {
+        float lo = 1e30f, hi = -1e30f;
+        for (int j = 0; j < count; j++) {
+            lo = children[j]->lo[a] < lo ? children[j]->lo[a] : lo;
+            hi = children[j]->hi[a] > hi ? children[j]->hi[a] : hi;
+        }
+
+        // smallest power of two cell that covers the node in 255 steps
+        int exponent = 0;
+        while (exponent < 127 && powerOfTwo(exponent) * 255 < hi - lo)
+            exponent++;
+        while (exponent > -126 && powerOfTwo(exponent - 1) * 255 >= hi - lo)
+            exponent--;
+
+        float scale = powerOfTwo(exponent);
+        node.origin[a] = lo;
+        node.exponent[a] = int8_t(exponent);
+
+        for (int j = 0; j < QBVH_WIDTH; j++) {
+            if (j >= count) {
+                node.qlo[a][j] = 255;
+                node.qhi[a][j] = 0;
+                continue;
+            }
+
+            float x = (children[j]->lo[a] - lo) / scale;
+            int q = x > 0 ? int(x) : 0;
+            while (q > 0 && lo + q * scale > children[j]->lo[a])
+                q--;
+            node.qlo[a][j] = uint8_t(q);
+
+            x = (children[j]->hi[a] - lo) / scale;
+            q = x > 0 ? int(x) : 0;
+            q = q < x ? q + 1 : q;
+            q = q > 255 ? 255 : q;
+            while (q < 255 && lo + q * scale < children[j]->hi[a])
+                q++;
+            node.qhi[a][j] = uint8_t(q);
+        }
+    }
+}
+
+// Collapses a tree from buildBVH into a 4-wide one: every node takes the biggest nodes below it
+// until it has four children. nodes needs room for as many nodes as the binary tree has, returns
+// the number of nodes used. Leaves keep their primitives, in the same order.
+constexpr uint32_t buildQBVH(const BVHNode* binary, QBVHNode* nodes) {
+    uint32_t nodeCount = 1;
+
+    uint32_t stack[BVH_STACK_SIZE * QBVH_WIDTH][2] = {};   // QBVH node, binary node
+    int stackSize = 0;
+    stack[stackSize][0] = 0;
+    stack[stackSize][1] = 0;
+    stackSize++;
+
+    while (stackSize > 0) {
+        stackSize--;
+        QBVHNode& node = nodes[stack[stackSize][0]];
+        const BVHNode& source = binary[stack[stackSize][1]];
+
+        const BVHNode* children[QBVH_WIDTH] = {};
+        int count = 0;
+        if (source.count > 0) {
+            children[count++] = &source; // a tree that is one leaf
+        } else {
+            children[count++] = &binary[source.leftFirst];
+            children[count++] = &binary[source.leftFirst + 1];
+        }
+
+        while (count < QBVH_WIDTH) {
+            int open = -1;
+            float openArea = -1;
+            for (int j = 0; j < count; j++) {
+                AABB box;
+                for (int a = 0; a < 3; a++) {
+                    box.lo[a] = children[j]->lo[a];
+                    box.hi[a] = children[j]->hi[a];
+                }
+                if (children[j]->count == 0 && box.area() > openArea) {
+                    open = j;
+                    openArea = box.area();
+                }
+            }
+            if (open < 0)
+                break;
+
+            const BVHNode* opened = children[open];
+            children[open] = &binary[opened->leftFirst];
+            children[count++] = &binary[opened->leftFirst + 1];
+        }
+
+        node = QBVHNode{};
+        quantizeChildren(node, children, count);
+
+        for (int j = 0; j < QBVH_WIDTH; j++) {
+            if (j >= count) {
+                node.child[j] = QBVH_EMPTY;
+            } else if (children[j]->count > 0) {
+                node.child[j] = children[j]->leftFirst;
+                node.count[j] = uint16_t(children[j]->count);
+            } else {
+                node.child[j] = nodeCount;
+                stack[stackSize][0] = nodeCount++;
+                stack[stackSize][1] = uint32_t(children[j] - binary);
+                stackSize++;
+            }
+        }
+    }
+
+    return nodeCount;
+}
+
+// Recomputes the boxes of a tree from buildQBVH bottom up after its primitives moved, bounds are the
+// boxes of the primitives in leaf order. The structure stays the same, so the tree gets worse the
+// further the primitives move from where it was built (see qbvhCost). Returns the box of the node.
+inline AABB refitQBVH(QBVHNode* nodes, const AABB* bounds, uint32_t index = 0) {
+    QBVHNode& node = nodes[index];
+
+    AABB boxes[QBVH_WIDTH];
+    const AABB* children[QBVH_WIDTH] = {};
+    int count = 0;
+    for (; count < QBVH_WIDTH && node.child[count] != QBVH_EMPTY; count++) {
+        if (node.count[count] > 0) {
+            for (uint32_t i = node.child[count]; i < node.child[count] + node.count[count]; i++)
+                boxes[count].grow(bounds[i]);
+        } else {
+            boxes[count] = refitQBVH(nodes, bounds, node.child[count]);
+        }
+        children[count] = &boxes[count];
+    }
+
+    quantizeChildren(node, children, count);
+
+    AABB box;
+    for (int j = 0; j < count; j++)
+        box.grow(boxes[j]);
+    return box;
+}
+
+// Surface area heuristic of a 4-wide tree: the box and primitive tests a random ray does, weighted by
+// the area of the boxes (the chance such a ray enters them). Lower is better, trees over the same
+// primitives in any rigid position can be compared.
+inline float qbvhCost(const QBVHNode* nodes) {
+    float cost = 0;
+
+    uint32_t stack[BVH_STACK_SIZE * QBVH_WIDTH];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const QBVHNode& node = nodes[stack[--stackSize]];
+
+        AABB box;
+        for (int j = 0; j < QBVH_WIDTH && node.child[j] != QBVH_EMPTY; j++) {
+            AABB child;
+            for (int a = 0; a < 3; a++) {
+                child.lo[a] = node.origin[a] + node.qlo[a][j] * powerOfTwo(node.exponent[a]);
+                child.hi[a] = node.origin[a] + node.qhi[a][j] * powerOfTwo(node.exponent[a]);
+            }
+            box.grow(child);
+
+            if (node.count[j] > 0)
+                cost += child.area() * node.count[j];
+            else
+                stack[stackSize++] = node.child[j];
+        }
+
+        cost += box.area();
+    }
+
+    return cost;
+}
+
+// Same visit as traverseBVH for a 4-wide tree: children are entered closest first and skipped
+// once closest is in front of them
+template<class Intersect>
+inline void traverseQBVH(const QBVHNode* nodes, const Ray& r, float t_min, float& closest, Intersect&& intersect) {
+    vec3 invDirection(1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z);
+    const float o[3] = { r.origin.x, r.origin.y, r.origin.z };
+    const float inv[3] = { invDirection.x, invDirection.y, invDirection.z };
+
+    struct Entry {
+        uint32_t child;
+        uint32_t count;
+        float distance;
+    };
+
+    Entry stack[BVH_STACK_SIZE * QBVH_WIDTH];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, 0, t_min };
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        if (entry.distance > closest)
+            continue;
+
+        if (entry.count > 0) {
+            for (uint32_t i = 0; i < entry.count; i++)
+                intersect(entry.child + i, closest);
+            continue;
+        }
+
+        const QBVHNode& node = nodes[entry.child];
+        g_traceCost.steps++;
+
+        // t of a plane is q * scale * inv + (origin - o) * inv
+        float a[3], b[3];
+        for (int k = 0; k < 3; k++) {
+            a[k] = (node.origin[k] - o[k]) * inv[k];
+            b[k] = powerOfTwo(node.exponent[k]) * inv[k];
+        }
+
+        Entry hits[QBVH_WIDTH];
+        int hitCount = 0;
+
+        for (int j = 0; j < QBVH_WIDTH; j++) {
+            if (node.child[j] == QBVH_EMPTY)
+                continue;
+
+            float tx1 = node.qlo[0][j] * b[0] + a[0], tx2 = node.qhi[0][j] * b[0] + a[0];
+            float tmin = fmin(tx1, tx2), tmax = fmax(tx1, tx2);
+            float ty1 = node.qlo[1][j] * b[1] + a[1], ty2 = node.qhi[1][j] * b[1] + a[1];
+            tmin = fmax(tmin, fmin(ty1, ty2)), tmax = fmin(tmax, fmax(ty1, ty2));
+            float tz1 = node.qlo[2][j] * b[2] + a[2], tz2 = node.qhi[2][j] * b[2] + a[2];
+            tmin = fmax(tmin, fmin(tz1, tz2)), tmax = fmin(tmax, fmax(tz1, tz2));
+
+            if (tmax >= tmin && tmax >= t_min && tmin <= closest) {
+                // sorted on distance, farthest first so the closest is popped first
+                int k = hitCount++;
+                while (k > 0 && hits[k - 1].distance < tmin) {
+                    hits[k] = hits[k - 1];
+                    k--;
+                }
+                hits[k] = { node.child[j], node.count[j], tmin };
+            }
+        }
+
+        for (int j = 0; j < hitCount; j++)
+            stack[stackSize++] = hits[j];
+    }
+}
+
+#endif
@@ -9,8 +9,6 @@ public:
     ~Camera() {}
 
     void update() {
-        const auto aspectRatio = 1.0; 
-
         auto viewportHeight = 2.0;
         auto viewportWidth = aspectRatio * viewportHeight;
         
@@ -24,6 +22,7 @@ public:
         horizontal = viewportWidth * u;
         vertical = viewportHeight * v;
         lower_left_corner = origin - horizontal/2 - vertical/2 - w;
+        changes++;
     }
 
     void setPosition(vec3 pos) { 
@@ -36,6 +35,16 @@ public:
         update();
     }
 
+    void setAspectRatio(float ratio) {
+        aspectRatio = ratio;
+        update();
+    }
+
+    vec3 position() const { return lookfrom; }
+
+    // goes up every time the rays change
+    unsigned generation() const { return changes; }
+
     Ray getRay(float s, float t) const {
         return Ray(origin, lower_left_corner + s*horizontal + t*vertical - origin);
     }
@@ -44,11 +53,14 @@ private:
     vec3 lookfrom;
     vec3 lookat;
     vec3 vup;
+    float aspectRatio = 1.0;
 
     vec3 origin;
     vec3 lower_left_corner;
     vec3 horizontal;
     vec3 vertical;
+
+    unsigned changes = 0;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "renderer.h"
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Accumulation state of an offline render: the settings it was started with and the raw
+// data/rayCounter buffers, so a long render can be stopped and resumed at any pass.
+// The header doubles as the description of a render that is sent to farm workers.
+
+// Set on Ctrl+C (SIGINT) or SIGTERM by the cli, renders stop after their last complete pass and keep its checkpoint
+inline volatile std::sig_atomic_t g_interrupted = 0;
+
+struct CheckpointHeader {
+    char magic[4] = { 'R', 'T', 'X', 'D' };
+    uint32_t version = 4;
+
+    int32_t level = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    uint32_t seed = 0;
+    uint32_t samples = 0;        // passes that are already in the buffers
+
+    int32_t customCamera = 0;    // 0 when the camera of the level is used
+    float from[3] = { 0, 0, 0 };
+    float at[3] = { 0, 0, 0 };
+
+    int32_t renderMode = RENDER_COLOR;
+    float heatmapScale = 0;
+    int32_t radianceCache = 0;   // paths end in the radiance cache, the cache itself is not stored
+    int32_t primaryCache = 0;    // camera samples at cached sub-pixel positions, same
+
+    bool sameRender(const CheckpointHeader& other) const {
+        bool sameCamera = customCamera == other.customCamera;
+        for (int i = 0; i < 3 && customCamera; i++)
+            sameCamera = sameCamera && from[i] == other.from[i] && at[i] == other.at[i];
+
+        return level == other.level && width == other.width && height == other.height
+            && seed == other.seed && sameCamera
+            && renderMode == other.renderMode && heatmapScale == other.heatmapScale
+            && radianceCache == other.radianceCache && primaryCache == other.primaryCache;
+    }
+};
+
+// Loads the level and points the camera of a render, the same way for a fresh and a resumed one
+inline void applyRenderSettings(const CheckpointHeader& settings) {
+    srand48(settings.seed); // world3 is randomized
+    g_samplerSeed = settings.seed;
+    loadWorld(settings.level);
+    setResolution(settings.width, settings.height);
+    setRenderMode(settings.renderMode, settings.heatmapScale);
+    setRadianceCache(settings.radianceCache);
+    setPrimaryCache(settings.primaryCache);
+
+    if (settings.customCamera) {
+        g_camera.setPosition(vec3(settings.from[0], settings.from[1], settings.from[2]));
+        g_camera.setLookat(vec3(settings.at[0], settings.at[1], settings.at[2]));
+    }
+}
+
+// Streams the header and both buffers to a temporary file and renames it over the old checkpoint,
+// an interrupted write never leaves a broken checkpoint behind
+inline bool saveCheckpoint(const std::string& path, const CheckpointHeader& header,
+                           const std::vector<float>& data, const std::vector<float>& rayCounter) {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(rayCounter.data()), rayCounter.size() * sizeof(float));
+
+        if (!out.flush())
+            return false;
+    }
+
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// Reads a checkpoint written by saveCheckpoint, the buffers are resized to the size in the header
+inline bool loadCheckpoint(const std::string& path, CheckpointHeader& header,
+                           std::vector<float>& data, std::vector<float>& rayCounter, int channels) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    CheckpointHeader expected;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::string(header.magic, 4) != std::string(expected.magic, 4) || header.version != expected.version)
+        return false;
+
+    size_t pixels = size_t(header.width) * size_t(header.height);
+    data.resize(pixels * channels);
+    rayCounter.resize(pixels);
+
+    in.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(rayCounter.data()), rayCounter.size() * sizeof(float));
+
+    return bool(in);
+}
+
+#endif
@@ -0,0 +1,398 @@
+// Native command line front end for the tracer, not part of the wasm build.
+//
+//   g++ -O3 -std=c++20 -I. cli.cpp -o cli
+//
+//   ./cli render --level 2 --width 1920 --height 1080 --spp 4096 --out level2.ppm
+//
+// Renders write a checkpoint (default: <out>.ckpt) every --every passes and on Ctrl+C,
+// running the same command again with --resume continues from it.
+//
+//   ./cli farm --workers 8 --level 2 --spp 4096 --out level2.ppm
+//
+// renders the same frame on worker processes (see farm.h), its checkpoint can be resumed by both.
+//
+//   ./cli render --level 3 --mode tests --spp 16 --out level3_tests.ppm
+//
+// renders a heatmap of the cost of every pixel instead of its colour (see renderSample in renderer.h).
+// --cache lets paths end in the radiance cache after their first diffuse bounce (radiance_cache.h),
+// --primary-cache starts the samples at cached first hits of fixed sub-pixel positions (primary_cache.h).
+//
+//   ./cli serve --level 2 --spp 256 &
+//   ./cli client --level 2 --spp 256 --out level2.ppm
+//
+// renders on a server process that streams the changed tiles of the image to the client (see server.h).
+
+#include "renderer.h"
+#include "checkpoint.h"
+#include "farm.h"
+#include "server.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+struct Options {
+    int level = 1;
+    int width = IMAGE_WIDTH;
+    int height = IMAGE_HEIGHT;
+    int spp = 64;
+    int every = 16;
+    unsigned seed = 51;
+    bool resume = false;
+
+    int workers = 4;
+    int tile = 64;
+
+    int port = SERVER_PORT;
+    bool stop = false;
+
+    bool customCamera = false;
+    vec3 from, at;
+
+    int mode = RENDER_COLOR;
+    float heatScale = 0;
+    bool radianceCache = false;
+    bool primaryCache = false;
+
+    std::string out = "render.ppm";
+    std::string checkpoint;
+};
+
+static void catchInterrupts() {
+    std::signal(SIGINT, [](int) { g_interrupted = 1; });
+    std::signal(SIGTERM, [](int) { g_interrupted = 1; });
+}
+
+static bool parseVec3(const char* text, vec3& v) {
+    return sscanf(text, "%f,%f,%f", &v.x, &v.y, &v.z) == 3;
+}
+
+static bool parseMode(const std::string& name, int& mode) {
+    const char* names[] = { "color", "tests", "steps", "bounces", "time" };
+    for (int i = RENDER_COLOR; i <= RENDER_TIME; i++) {
+        if (name == names[i]) {
+            mode = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (arg == "--resume") {
+            options.resume = true;
+            continue;
+        }
+        if (arg == "--cache") {
+            options.radianceCache = true;
+            continue;
+        }
+        if (arg == "--primary-cache") {
+            options.primaryCache = true;
+            continue;
+        }
+        if (arg == "--stop") {
+            options.stop = true;
+            continue;
+        }
+
+        if (value == nullptr) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        i++;
+
+        if (arg == "--level")           options.level = atoi(value);
+        else if (arg == "--width")      options.width = atoi(value);
+        else if (arg == "--height")     options.height = atoi(value);
+        else if (arg == "--spp")        options.spp = atoi(value);
+        else if (arg == "--every")      options.every = atoi(value);
+        else if (arg == "--seed")       options.seed = unsigned(strtoul(value, nullptr, 10));
+        else if (arg == "--out")        options.out = value;
+        else if (arg == "--checkpoint") options.checkpoint = value;
+        else if (arg == "--workers")    options.workers = atoi(value);
+        else if (arg == "--tile")       options.tile = atoi(value);
+        else if (arg == "--port")       options.port = atoi(value);
+        else if (arg == "--heat-scale") options.heatScale = float(atof(value));
+        else if (arg == "--mode" && parseMode(value, options.mode)) {}
+        else if (arg == "--from" && parseVec3(value, options.from)) options.customCamera = true;
+        else if (arg == "--at" && parseVec3(value, options.at))     options.customCamera = true;
+        else {
+            fprintf(stderr, "unknown option %s %s\n", arg.c_str(), value);
+            return false;
+        }
+    }
+
+    if (options.checkpoint.empty())
+        options.checkpoint = options.out + ".ckpt";
+
+    return options.width > 0 && options.height > 0 && options.spp > 0 && options.every > 0
+        && options.workers > 0 && options.tile > 0;
+}
+
+static CheckpointHeader headerFor(const Options& options, int samples) {
+    CheckpointHeader header;
+    header.level = options.level;
+    header.width = options.width;
+    header.height = options.height;
+    header.seed = options.seed;
+    header.samples = samples;
+    header.customCamera = options.customCamera;
+    header.renderMode = options.mode;
+    header.heatmapScale = options.heatScale;
+    header.radianceCache = options.radianceCache;
+    header.primaryCache = options.primaryCache;
+
+    float from[3] = { options.from.x, options.from.y, options.from.z };
+    float at[3] = { options.at.x, options.at.y, options.at.z };
+    std::copy(from, from + 3, header.from);
+    std::copy(at, at + 3, header.at);
+
+    return header;
+}
+
+// Binary PPM of the averaged samples, clamped to [0, 1]
+static bool writePPM(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "P6\n%d %d\n255\n", g_width, g_height);
+
+    std::vector<unsigned char> row(g_width * 3);
+    for (int y = 0; y < g_height; y++) { // same row order as the canvas in index.html
+        for (int x = 0; x < g_width; x++) {
+            int index = y * g_width + x;
+            float count = rayCounter[index] > 0 ? rayCounter[index] : 1;
+
+            for (int c = 0; c < 3; c++) {
+                float value = data[index * COLOR_CHANNELS + c] / count;
+                value = value < 0 ? 0 : (value > 1 ? 1 : value);
+                row[x * 3 + c] = static_cast<unsigned char>(value * 255.99f);
+            }
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+
+    return fclose(file) == 0;
+}
+
+// Loads the checkpoint into data/rayCounter when asked to resume, returns false if it cannot be used
+static bool resume(const Options& options, const CheckpointHeader& header, int& samples) {
+    samples = 0;
+    if (!options.resume)
+        return true;
+
+    CheckpointHeader stored;
+    std::vector<float> storedData, storedCounter;
+
+    if (!loadCheckpoint(options.checkpoint, stored, storedData, storedCounter, COLOR_CHANNELS)) {
+        fprintf(stderr, "no usable checkpoint at %s, starting from scratch\n", options.checkpoint.c_str());
+        return true;
+    }
+
+    if (!stored.sameRender(header)) {
+        fprintf(stderr, "%s belongs to a different render (level/size/seed/camera/mode/cache)\n", options.checkpoint.c_str());
+        return false;
+    }
+
+    data = storedData;
+    rayCounter = storedCounter;
+    samples = stored.samples;
+    printf("Resuming at %d/%d samples\n", samples, options.spp);
+    return true;
+}
+
+static int renderCommand(const Options& options) {
+    CheckpointHeader header = headerFor(options, 0);
+    applyRenderSettings(header);
+
+    int samples;
+    if (!resume(options, header, samples))
+        return 1;
+
+    catchInterrupts();
+
+    auto start = std::chrono::steady_clock::now();
+    int rendered = 0;
+
+    while (samples < options.spp && !g_interrupted) {
+        // every pass has its own seed, a resumed render continues the exact same sequence
+        srand48(options.seed + samples);
+        render();
+        samples++;
+        rendered++;
+
+        if (samples % options.every == 0 || samples == options.spp || g_interrupted) {
+            if (!saveCheckpoint(options.checkpoint, headerFor(options, samples), data, rayCounter)) {
+                fprintf(stderr, "could not write %s\n", options.checkpoint.c_str());
+                return 1;
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("%d/%d samples, %.2f s per sample\n", samples, options.spp, seconds / rendered);
+            fflush(stdout);
+        }
+    }
+
+    if (!writePPM(options.out)) {
+        fprintf(stderr, "could not write %s\n", options.out.c_str());
+        return 1;
+    }
+
+    printf("Wrote %s (%d samples)%s\n", options.out.c_str(), samples, g_interrupted ? ", interrupted" : "");
+    return 0;
+}
+
+// Same render as renderCommand, with the passes spread over worker processes
+static int farmCommand(const Options& options) {
+    CheckpointHeader header = headerFor(options, 0);
+    applyRenderSettings(header);
+
+    int samples;
+    if (!resume(options, header, samples))
+        return 1;
+
+    catchInterrupts();
+
+    auto start = std::chrono::steady_clock::now();
+    int firstSample = samples;
+    FarmStats stats;
+
+    // called with the passes in order: data/rayCounter hold exactly samples [0, done)
+    auto passesDone = [&](int done) {
+        samples = done;
+        if (!saveCheckpoint(options.checkpoint, headerFor(options, samples), data, rayCounter)) {
+            fprintf(stderr, "could not write %s\n", options.checkpoint.c_str());
+            return false;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%d/%d samples, %.2f s per sample\n", samples, options.spp, seconds / (samples - firstSample));
+        fflush(stdout);
+        return true;
+    };
+
+    if (samples < options.spp && !farmRender(header, options.workers, options.tile, options.every, samples, options.spp, stats, passesDone)
+        && !g_interrupted) {
+        fprintf(stderr, "farm render failed\n");
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rays = double(samples - firstSample) * options.width * options.height;
+    printf("%d workers, %d jobs, %.1f MB received, %.2f s, %.2f Mrays/s (primary)\n", options.workers, stats.jobs,
+           stats.bytesReceived / 1e6, seconds, rays / seconds / 1e6);
+
+    if (!writePPM(options.out)) {
+        fprintf(stderr, "could not write %s\n", options.out.c_str());
+        return 1;
+    }
+
+    printf("Wrote %s (%d samples)%s\n", options.out.c_str(), samples, g_interrupted ? ", interrupted" : "");
+    return 0;
+}
+
+// Renders on the server for as long as it is running, --spp passes after every change
+static int serveCommand(const Options& options) {
+    if (!runServer(headerFor(options, 0), options.port, options.spp)) {
+        fprintf(stderr, "could not listen on port %d\n", options.port);
+        return 1;
+    }
+    return 0;
+}
+
+// Shows the level (and camera) on a running server, receives frames until --spp passes and saves the image
+static int clientCommand(const Options& options) {
+    RenderClient client;
+    if (!client.connectTo(options.port)) {
+        fprintf(stderr, "no server on port %d\n", options.port);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t waitFor = client.send(COMMAND_LEVEL, { float(options.level) });
+    if (options.customCamera) {
+        waitFor = client.send(COMMAND_CAMERA, { options.from.x, options.from.y, options.from.z,
+                                                options.at.x, options.at.y, options.at.z });
+    }
+
+    int frames = 0;
+    double latency = -1;
+    while (client.receive()) {
+        frames++;
+        if (client.last.lastCommand < waitFor)
+            continue;
+
+        if (latency < 0)
+            latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (client.last.done || int(client.last.samples) >= options.spp)
+            break;
+    }
+
+    client.send(options.stop ? COMMAND_SHUTDOWN : COMMAND_QUIT);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double raw = double(frames) * client.image.size();
+    printf("%d frames, %u samples, %.2f MB received (%.1f%% of the full frames), first frame after %.1f ms, %.2f s\n",
+           frames, client.last.samples, client.bytesReceived / 1e6, 100.0 * client.bytesReceived / std::max(raw, 1.0),
+           latency * 1e3, seconds);
+
+    FILE* file = fopen(options.out.c_str(), "wb");
+    if (file == nullptr || client.image.empty()) {
+        fprintf(stderr, "could not write %s\n", options.out.c_str());
+        return 1;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", client.last.width, client.last.height);
+    for (size_t i = 0; i < client.image.size(); i += BUFFER_CHANNELS)
+        fwrite(&client.image[i], 1, 3, file);
+    fclose(file);
+
+    printf("Wrote %s\n", options.out.c_str());
+    return 0;
+}
+
+static void usage() {
+    printf("usage: cli render [--level N] [--width W] [--height H] [--spp N] [--out image.ppm]\n"
+           "                  [--from x,y,z --at x,y,z] [--seed S]\n"
+           "                  [--checkpoint file] [--every N] [--resume]\n"
+           "                  [--mode color|tests|steps|bounces|time] [--heat-scale N] [--cache] [--primary-cache]\n"
+           "       cli farm   <render options> [--workers N] [--tile N]\n"
+           "                  passes are cut in tiles of --every samples and rendered by worker processes\n"
+           "       cli serve  <render options> [--port N]\n"
+           "                  renders --spp passes after every change and streams the changed tiles to a client\n"
+           "       cli client [--level N] [--from x,y,z --at x,y,z] [--spp N] [--out image.ppm] [--port N] [--stop]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    if (command == "render")
+        return renderCommand(options);
+    if (command == "farm")
+        return farmCommand(options);
+    if (command == "serve")
+        return serveCommand(options);
+    if (command == "client")
+        return clientCommand(options);
+
+    usage();
+    return 1;
+}
@@ -60,6 +60,18 @@ namespace MATH
     inline vec3 randomUnitVector() {
         return unitVector(randomInUnitSphere());
     }
+
+    // Same distributions as above from given uniform numbers in [0, 1), for the Sampler
+    inline vec3 unitVectorFrom(float u, float v) {
+        float z = 1 - 2 * u;
+        float r = sqrt(fmax(0.0f, 1 - z*z));
+        float phi = 2 * PI * v;
+        return vec3(r * cos(phi), r * sin(phi), z);
+    }
+
+    inline vec3 inUnitSphereFrom(float u, float v, float w) {
+        return cbrt(w) * unitVectorFrom(u, v);
+    }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,286 @@
+// GENERATED by obj_to_code.py from assets/badeend_body.obj assets/badeend_bekkie.obj, do not edit
+#ifndef EEND_MESH_H
+#define EEND_MESH_H
+
+inline constexpr int EEND_TRIANGLE_COUNT = 162;
+
+inline constexpr float EEND_VERTICES[] = {
+    0.087912,0.125404,0.015093,
+    0.690974,0.355502,0.015093,
+    0.528428,-1.029138,0.015093,
+    1.131490,-0.799040,0.015093,
+    0.548791,-1.024570,-0.149538,
+    1.135908,-0.796847,-0.194219,
+    0.181312,-0.105612,-0.492830,
+    0.810941,0.248472,-0.454867,
+    0.005545,0.355054,-0.336059,
+    0.539749,0.624919,-0.332684,
+    0.217468,-0.557775,-0.262964,
+    0.197870,0.237193,-0.167597,
+    0.987405,-0.750910,-0.804983,
+    0.000000,0.739798,-0.619836,
+    0.520474,0.871404,-0.935887,
+    0.000000,1.214297,-1.055864,
+    0.304106,-0.251183,-1.636693,
+    0.290171,0.574738,-0.772875,
+    0.052640,1.540373,-2.415132,
+    0.000000,1.132595,-0.724539,
+    0.000000,1.631587,-2.353452,
+    0.206976,-0.883530,-2.054593,
+    0.206976,-0.883530,-1.589238,
+    0.314795,-0.883530,-1.911020,
+    0.307225,-0.883530,-1.736031,
+    0.000000,-0.883530,-2.116803,
+    0.000000,-0.883530,-1.503144,
+    0.578638,-0.444373,-2.186206,
+    0.000000,-0.449198,-2.364102,
+    0.510330,0.024206,-2.361554,
+    0.000000,-0.025428,-2.504842,
+    0.273229,0.506053,-2.257170,
+    0.000000,0.565457,-2.419547,
+    0.350594,0.685522,-1.946242,
+    0.000000,0.830967,-1.876271,
+    0.472005,0.437742,-1.581011,
+    0.000000,0.520890,-1.422050,
+    0.707702,-0.381498,-1.560577,
+    0.000000,-0.454159,-1.370782,
+    0.000000,-1.325317,-0.794878,
+    0.000000,-0.621679,-0.136697,
+    0.000000,0.237193,-0.152152,
+    -0.087912,0.125404,0.015093,
+    -0.690974,0.355502,0.015093,
+    -0.528428,-1.029138,0.015093,
+    -1.131490,-0.799040,0.015093,
+    -0.548791,-1.024570,-0.149538,
+    -1.135908,-0.796847,-0.194219,
+    -0.181312,-0.105612,-0.492830,
+    -0.810941,0.248472,-0.454867,
+    -0.005545,0.355054,-0.336059,
+    -0.539749,0.624919,-0.332684,
+    -0.217468,-0.557775,-0.262964,
+    -0.197870,0.237193,-0.167597,
+    -0.987405,-0.750910,-0.804983,
+    -0.520474,0.871404,-0.935887,
+    -0.304106,-0.251183,-1.636693,
+    -0.290171,0.574738,-0.772875,
+    -0.052640,1.540373,-2.415132,
+    -0.206976,-0.883530,-2.054593,
+    -0.206976,-0.883530,-1.589238,
+    -0.314795,-0.883530,-1.911020,
+    -0.307225,-0.883530,-1.736031,
+    -0.578638,-0.444373,-2.186206,
+    -0.510330,0.024206,-2.361554,
+    -0.273229,0.506053,-2.257170,
+    -0.350594,0.685522,-1.946242,
+    -0.472005,0.437742,-1.581011,
+    -0.707702,-0.381498,-1.560577,
+    0.299420,-1.232704,-2.219378,
+    0.206976,-0.883530,-2.054593,
+    0.299420,-1.232704,-1.426848,
+    0.206976,-0.883530,-1.589238,
+    -0.015276,-1.232116,-1.357659,
+    0.314795,-0.883530,-1.911020,
+    0.307225,-0.883530,-1.736031,
+    -0.015276,-1.232116,-2.279707,
+    0.000000,-0.883530,-2.116803,
+    0.000000,-0.883530,-1.503144,
+    -0.015276,-1.233292,-1.494325,
+    -0.015276,-1.233292,-2.134024,
+    0.432723,-1.232116,-1.658111,
+    0.294171,-1.232704,-1.946138,
+    0.432723,-1.232116,-1.996966,
+    0.294171,-1.232704,-1.696223,
+    0.184962,-1.233292,-1.543204,
+    0.184962,-1.233292,-2.092628,
+    -0.015276,-1.095139,-1.928303,
+    -0.015276,-1.095139,-1.689764,
+    -0.329972,-1.232704,-2.219378,
+    -0.206976,-0.883530,-2.054593,
+    -0.329972,-1.232704,-1.426848,
+    -0.206976,-0.883530,-1.589238,
+    -0.314795,-0.883530,-1.911020,
+    -0.307225,-0.883530,-1.736031,
+    -0.463275,-1.232116,-1.658111,
+    -0.324722,-1.232704,-1.946138,
+    -0.463275,-1.232116,-1.996966,
+    -0.324722,-1.232704,-1.696223,
+    -0.215513,-1.233292,-1.543204,
+    -0.215513,-1.233292,-2.092628,
+};
+
+inline constexpr unsigned short EEND_INDICES[] = {
+    2,3,1,
+    3,2,4,
+    5,4,6,
+    7,6,8,
+    8,6,0,
+    4,0,6,
+    2,0,4,
+    1,8,0,
+    8,1,9,
+    9,1,7,
+    7,1,5,
+    1,3,5,
+    11,12,14,
+    13,14,15,
+    14,12,16,
+    14,16,15,
+    18,19,17,
+    21,25,28,
+    28,30,29,
+    30,32,31,
+    23,37,24,
+    33,34,36,
+    35,36,38,
+    22,37,38,
+    24,37,22,
+    23,21,27,
+    31,32,34,
+    37,29,27,
+    39,54,56,
+    10,39,12,
+    39,10,40,
+    10,11,40,
+    40,11,41,
+    11,13,41,
+    35,29,31,
+    17,58,18,
+    43,45,44,
+    46,44,45,
+    48,46,47,
+    50,48,49,
+    50,42,48,
+    46,48,42,
+    44,46,42,
+    43,42,50,
+    50,51,43,
+    51,49,43,
+    49,47,43,
+    43,47,45,
+    53,54,52,
+    13,55,53,
+    55,56,54,
+    55,15,56,
+    19,58,57,
+    28,25,59,
+    28,63,64,
+    30,64,65,
+    61,68,63,
+    36,34,66,
+    38,36,67,
+    60,26,38,
+    62,60,68,
+    61,59,63,
+    34,32,65,
+    64,63,68,
+    12,39,16,
+    52,54,39,
+    39,40,52,
+    52,40,53,
+    40,41,53,
+    53,41,13,
+    65,64,67,
+    17,19,57,
+    20,18,58,
+    16,39,56,
+    16,56,15,
+    2,1,0,
+    3,4,5,
+    5,6,7,
+    7,8,9,
+    11,10,12,
+    13,11,14,
+    18,20,19,
+    21,28,27,
+    28,29,27,
+    30,31,29,
+    23,27,37,
+    33,36,35,
+    35,38,37,
+    22,38,26,
+    31,34,33,
+    37,29,35,
+    35,31,33,
+    17,57,58,
+    43,44,42,
+    46,45,47,
+    48,47,49,
+    50,49,51,
+    53,55,54,
+    13,15,55,
+    19,20,58,
+    28,59,63,
+    28,64,30,
+    30,65,32,
+    61,62,68,
+    36,66,67,
+    38,67,68,
+    60,38,68,
+    34,65,66,
+    64,68,67,
+    65,67,66,
+    81,72,71,
+    69,74,83,
+    76,86,80,
+    70,76,77,
+    72,73,71,
+    83,75,81,
+    85,73,79,
+    69,82,86,
+    81,82,83,
+    71,84,81,
+    84,87,82,
+    82,87,86,
+    80,86,87,
+    84,85,88,
+    79,88,85,
+    92,95,91,
+    89,93,90,
+    100,76,80,
+    90,76,89,
+    92,73,78,
+    94,97,95,
+    99,73,91,
+    89,96,97,
+    96,95,97,
+    98,91,95,
+    87,98,96,
+    96,100,87,
+    80,87,100,
+    98,88,99,
+    79,99,88,
+    81,75,72,
+    69,70,74,
+    76,69,86,
+    70,69,76,
+    72,78,73,
+    83,74,75,
+    85,71,73,
+    69,83,82,
+    81,84,82,
+    71,85,84,
+    84,88,87,
+    92,94,95,
+    89,97,93,
+    100,89,76,
+    90,77,76,
+    92,91,73,
+    94,93,97,
+    99,79,73,
+    89,100,96,
+    96,98,95,
+    98,99,91,
+    87,88,98,
+};
+
+// material slot per triangle
+inline constexpr unsigned char EEND_MATERIALS[] = {
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,
+};
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include "renderer.h"
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Renders one frame with several worker processes. The coordinator cuts the frame into tiles and
+// sample ranges, workers trace them with the normal renderer and send back the partial sums and counts
+// of the tile in the data/rayCounter layout, the coordinator adds them to its own buffers.
+//
+// Everything goes over a byte stream: the render settings (a CheckpointHeader) once, then FarmJobs
+// and their results. Workers are started locally with fork() over a socketpair, a remote worker
+// only needs a socket that speaks the same messages.
+
+struct FarmJob {
+    int32_t x0, y0, x1, y1;
+    uint32_t sampleStart;
+    uint32_t sampleCount;   // 0 tells the worker to quit
+};
+
+inline bool writeAll(int fd, const void* buffer, size_t bytes) {
+    auto p = static_cast<const char*>(buffer);
+    while (bytes > 0) {
+        ssize_t written = write(fd, p, bytes);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        p += written;
+        bytes -= written;
+    }
+    return true;
+}
+
+inline bool readAll(int fd, void* buffer, size_t bytes) {
+    auto p = static_cast<char*>(buffer);
+    while (bytes > 0) {
+        ssize_t got = read(fd, p, bytes);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        p += got;
+        bytes -= got;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////// WORKER
+
+// Traces the tile of a job into the (cleared) global buffers and copies it out, pixels row by row.
+// The counters start at sampleStart so the sampler continues the sequence of every pixel.
+inline void renderFarmJob(const CheckpointHeader& settings, const FarmJob& job,
+                          std::vector<float>& tileData, std::vector<float>& tileCounter) {
+    for (int y = job.y0; y < job.y1; y++) {
+        int row = y * g_width;
+        std::fill(data.begin() + (row + job.x0) * COLOR_CHANNELS, data.begin() + (row + job.x1) * COLOR_CHANNELS, 0.0f);
+        std::fill(rayCounter.begin() + row + job.x0, rayCounter.begin() + row + job.x1, float(job.sampleStart));
+    }
+
+    for (uint32_t s = job.sampleStart; s < job.sampleStart + job.sampleCount; s++) {
+        // every tile and pass has its own seed so the result does not depend on which worker ran it
+        srand48(long(settings.seed) * 1000003 + long(s) * 7919 + job.y0 * g_width + job.x0);
+        renderTile(job.x0, job.y0, job.x1, job.y1);
+    }
+
+    tileData.clear();
+    tileCounter.clear();
+    for (int y = job.y0; y < job.y1; y++) {
+        int row = y * g_width;
+        tileData.insert(tileData.end(), data.begin() + (row + job.x0) * COLOR_CHANNELS, data.begin() + (row + job.x1) * COLOR_CHANNELS);
+        for (int x = job.x0; x < job.x1; x++)
+            tileCounter.push_back(rayCounter[row + x] - float(job.sampleStart));
+    }
+}
+
+// Serves jobs on fd until the coordinator sends a quit job or goes away
+inline int runFarmWorker(int fd) {
+    CheckpointHeader settings;
+    if (!readAll(fd, &settings, sizeof(settings)))
+        return 1;
+
+    applyRenderSettings(settings);
+
+    std::vector<float> tileData, tileCounter;
+    FarmJob job;
+    while (readAll(fd, &job, sizeof(job)) && job.sampleCount > 0) {
+        renderFarmJob(settings, job, tileData, tileCounter);
+
+        if (!writeAll(fd, &job, sizeof(job))
+            || !writeAll(fd, tileData.data(), tileData.size() * sizeof(float))
+            || !writeAll(fd, tileCounter.data(), tileCounter.size() * sizeof(float)))
+            return 1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////// COORDINATOR
+
+struct FarmStats {
+    int jobs = 0;
+    double bytesReceived = 0;
+};
+
+// Splits samples [sampleStart, sampleEnd) of the frame into tileSize tiles of at most chunk samples,
+// renders them on `workers` local processes and adds the results to data/rayCounter. The chunks are
+// added in order, passesDone(samples) is called after each one with the buffers holding exactly
+// [0, samples) so it can write a checkpoint, returning false stops the render. Stops as well, with
+// the workers killed, when g_interrupted is set.
+template<class PassesDone>
+bool farmRender(const CheckpointHeader& settings, int workers, int tileSize, int chunk,
+                int sampleStart, int sampleEnd, FarmStats& stats, PassesDone&& passesDone) {
+    std::deque<FarmJob> queue;
+    for (int s = sampleStart; s < sampleEnd; s += chunk) {
+        for (int y = 0; y < settings.height; y += tileSize) {
+            for (int x = 0; x < settings.width; x += tileSize) {
+                FarmJob job;
+                job.x0 = x;
+                job.y0 = y;
+                job.x1 = std::min(x + tileSize, int(settings.width));
+                job.y1 = std::min(y + tileSize, int(settings.height));
+                job.sampleStart = s;
+                job.sampleCount = std::min(chunk, sampleEnd - s);
+                queue.push_back(job);
+            }
+        }
+    }
+    const int tilesPerChunk = int(queue.size()) / ((sampleEnd - sampleStart + chunk - 1) / chunk);
+
+    // a worker that dies must not take the coordinator down with it
+    signal(SIGPIPE, SIG_IGN);
+    fflush(stdout);
+
+    std::vector<int> sockets;
+    std::vector<pid_t> children;
+    for (int i = 0; i < workers; i++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+            return false;
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            // the coordinator decides when a worker stops, Ctrl+C in the terminal reaches the workers too
+            signal(SIGINT, SIG_IGN);
+            signal(SIGTERM, SIG_DFL);
+            for (int fd : sockets)
+                close(fd);
+            close(pair[0]);
+            _exit(runFarmWorker(pair[1]));
+        }
+
+        close(pair[1]);
+        if (pid < 0) {
+            close(pair[0]);
+            return false;
+        }
+
+        sockets.push_back(pair[0]);
+        children.push_back(pid);
+        writeAll(pair[0], &settings, sizeof(settings));
+    }
+
+    auto dispatch = [&](int fd) {
+        if (queue.empty())
+            return false;
+        bool sent = writeAll(fd, &queue.front(), sizeof(FarmJob));
+        if (sent)
+            queue.pop_front();
+        return sent;
+    };
+
+    std::vector<pollfd> busy;
+    for (int fd : sockets) {
+        if (dispatch(fd))
+            busy.push_back({ fd, POLLIN, 0 });
+    }
+
+    // Results of the chunk that is being completed are summed in pass, results of later chunks wait in
+    // pending, so data/rayCounter only ever get whole chunks
+    struct Result {
+        FarmJob job;
+        std::vector<float> tileData, tileCounter;
+    };
+    std::vector<float> passData(data.size(), 0.0f), passCounter(rayCounter.size(), 0.0f);
+    std::vector<Result> pending;
+    int chunkStart = sampleStart;
+    int chunkTiles = 0;
+
+    auto add = [&](const Result& result) {
+        const FarmJob& job = result.job;
+        int w = job.x1 - job.x0;
+        for (int y = job.y0; y < job.y1; y++) {
+            for (int x = job.x0; x < job.x1; x++) {
+                int index = y * g_width + x;
+                int tileIndex = (y - job.y0) * w + x - job.x0;
+                for (int c = 0; c < COLOR_CHANNELS; c++)
+                    passData[index * COLOR_CHANNELS + c] += result.tileData[tileIndex * COLOR_CHANNELS + c];
+                passCounter[index] += result.tileCounter[tileIndex];
+            }
+        }
+        chunkTiles++;
+    };
+
+    // Moves every complete chunk into data/rayCounter and reports it, false when passesDone says stop
+    auto completeChunks = [&]() {
+        while (chunkTiles == tilesPerChunk) {
+            // merge: partial sums and counts simply add up
+            for (size_t i = 0; i < data.size(); i++)
+                data[i] += passData[i];
+            for (size_t i = 0; i < rayCounter.size(); i++)
+                rayCounter[i] += passCounter[i];
+            std::fill(passData.begin(), passData.end(), 0.0f);
+            std::fill(passCounter.begin(), passCounter.end(), 0.0f);
+
+            chunkStart = std::min(chunkStart + chunk, sampleEnd);
+            chunkTiles = 0;
+            if (!passesDone(chunkStart))
+                return false;
+
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (int(pending[i].job.sampleStart) == chunkStart) {
+                    add(pending[i]);
+                    pending.erase(pending.begin() + i);
+                    i--;
+                }
+            }
+        }
+        return true;
+    };
+
+    bool ok = true;
+    Result result;
+    while (!busy.empty() && ok && !g_interrupted) {
+        if (poll(busy.data(), busy.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            ok = false;
+            break;
+        }
+
+        for (size_t i = 0; i < busy.size() && ok && !g_interrupted; i++) {
+            if (busy[i].revents == 0)
+                continue;
+
+            int fd = busy[i].fd;
+            FarmJob& job = result.job;
+            if (!readAll(fd, &job, sizeof(job))) {
+                ok = false;
+                break;
+            }
+
+            int w = job.x1 - job.x0;
+            int h = job.y1 - job.y0;
+            result.tileData.resize(w * h * COLOR_CHANNELS);
+            result.tileCounter.resize(w * h);
+            if (!readAll(fd, result.tileData.data(), result.tileData.size() * sizeof(float))
+                || !readAll(fd, result.tileCounter.data(), result.tileCounter.size() * sizeof(float))) {
+                ok = false;
+                break;
+            }
+
+            stats.jobs++;
+            stats.bytesReceived += sizeof(job) + (result.tileData.size() + result.tileCounter.size()) * sizeof(float);
+
+            if (int(job.sampleStart) == chunkStart)
+                add(result);
+            else
+                pending.push_back(result);
+            ok = completeChunks();
+
+            if (!dispatch(fd)) {
+                busy.erase(busy.begin() + i);
+                i--;
+            }
+        }
+    }
+
+    if (g_interrupted || !ok) {
+        for (pid_t pid : children)
+            kill(pid, SIGTERM);
+    }
+
+    FarmJob quit = { 0, 0, 0, 0, 0, 0 };
+    for (int fd : sockets) {
+        writeAll(fd, &quit, sizeof(quit));
+        close(fd);
+    }
+    for (pid_t pid : children)
+        waitpid(pid, nullptr, 0);
+
+    return ok && !g_interrupted && queue.empty() && chunkStart == sampleEnd;
+}
+
+#endif
@@ -3,11 +3,13 @@
 
 #include "common.h"
 #include "hittable.h"
+#include "sampler.h"
 
 class Material {
     public:
         virtual vec3 emitted() const { return vec3(0,0,0); }
-        virtual bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered) const = 0;
+        virtual bool diffuse() const { return false; } // scatters the same way whatever comes in, for the radiance cache
+        virtual bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered, Sampler& sampler) const = 0;
 };
 
 inline std::ostream& operator<<(std::ostream &out, const Material &r) {
@@ -19,11 +21,13 @@ class Unlit : public Material {
     public:
         Unlit(const color& a) : albedo(a) {}
 
+        bool diffuse() const override { return true; }
+
         vec3 emitted() const override {
             return albedo;
         }
 
-        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered) const override {
+        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered, Sampler& sampler) const override {
             outColor = albedo;
             return true;
         }
@@ -38,8 +42,12 @@ class Lambertian : public Material {
     public:
         Lambertian(const color& a) : albedo(a) {}
 
-        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered) const override {
-            auto scatter_direction = rec.normal + MATH::randomUnitVector();
+        bool diffuse() const override { return true; }
+
+        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered, Sampler& sampler) const override {
+            float u, v;
+            sampler.get2D(u, v);
+            auto scatter_direction = rec.normal + MATH::unitVectorFrom(u, v);
 
             // Catch degenerate scatter direction
             if (scatter_direction.near_zero())
@@ -60,9 +68,11 @@ class Metal : public Material {
     public:
         Metal(const vec3& a, float f) : albedo(a), fuzz(f < 1 ? f : 1) {}
 
-        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered) const override {
+        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered, Sampler& sampler) const override {
             vec3 reflected = reflect(unitVector(r_in.direction), rec.normal);
-            scattered = Ray(rec.point, reflected + fuzz*MATH::randomInUnitSphere());
+            float u, v;
+            sampler.get2D(u, v);
+            scattered = Ray(rec.point, reflected + fuzz*MATH::inUnitSphereFrom(u, v, sampler.get1D()));
             outColor = albedo;
             return (dot(scattered.direction, rec.normal) > 0);
         }
@@ -82,7 +92,7 @@ class Light : public Material {
             return lightColor;
         }
 
-        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered) const override {
+        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered, Sampler& sampler) const override {
             return false;
         }
 
@@ -94,7 +104,7 @@ class Dielectric : public Material {
     public:
         Dielectric(double index_of_refraction) : ir(index_of_refraction) {}
 
-        virtual bool scatter( const Ray& r_in, const hit& rec, vec3& attenuation, Ray& scattered ) const override {
+        virtual bool scatter( const Ray& r_in, const hit& rec, vec3& attenuation, Ray& scattered, Sampler& sampler ) const override {
             attenuation = color(1.0, 1.0, 1.0);
             // float refraction_ratio = rec.front_face ? (1.0/ir) : ir;
             float refraction_ratio = (1.0/ir);
@@ -105,7 +115,7 @@ class Dielectric : public Material {
 
             bool cannot_refract = refraction_ratio * sin_theta > 1.0;
             vec3 direction;
-            if (cannot_refract || reflectance(cos_theta, refraction_ratio) > MATH::random())
+            if (cannot_refract || reflectance(cos_theta, refraction_ratio) > sampler.get1D())
                 direction = reflect(unit_direction, rec.normal);
             else
                 direction = refract(unit_direction, rec.normal, refraction_ratio);
@@ -134,8 +144,12 @@ class Special : public Material {
             return lightColor;
         }
 
-        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered) const override {
-            auto scatter_direction = rec.normal + MATH::randomUnitVector();
+        bool diffuse() const override { return true; }
+
+        bool scatter(const Ray& r_in, const hit& rec, vec3& outColor, Ray& scattered, Sampler& sampler) const override {
+            float u, v;
+            sampler.get2D(u, v);
+            auto scatter_direction = rec.normal + MATH::unitVectorFrom(u, v);
 
             // Catch degenerate scatter direction
             if (scatter_direction.near_zero())
@@ -1,25 +1,53 @@
 import sys
 
-if (len(sys.argv) <= 1):
-    print("Please pass the path")
+# Converts obj files into a header with constexpr arrays, every obj file becomes one material slot:
+#   python obj_to_code.py NAME body.obj beak.obj > name_mesh.h
+
+if (len(sys.argv) <= 2):
+    print("Please pass the name and the path(s)")
     exit()
 
-f = open(sys.argv[1],"r")
-lines = f.readlines()
+name = sys.argv[1].upper()
 
 verticies = []
+indicies = []
+materials = []
+
+for material, path in enumerate(sys.argv[2:]):
+    f = open(path,"r")
+    lines = f.readlines()
+    offset = len(verticies) # obj indices start at 1 for every file
 
-print
+    for line in lines: # automaticly ignores #, o, s, vn ...
+        if (line.startswith("v ")):
+            data = line.strip("\n").split(" ")[1:]
+            verticies.append(data)
 
-for line in lines: # automaticly ignores #, o, s, vn ...
-    if (line.startswith("v")):
-        data = line.strip("\n").split(" ")[1:]
-        verticies.append(data)
+        if (line.startswith("f ")):
+            face = line.strip("\n").split(" ")[1:]
+            indicies.append([offset + int(i.split("/")[0]) - 1 for i in face])
+            materials.append(material)
 
-    if (line.startswith("f")):
-        indicies = line.strip("\n").split(" ")[1:]
-        print("add( make_shared<Triangle>(", end="")
-        print("vec3({},{},{}),".format(*verticies[int(indicies[0]) - 1]), end="")
-        print("vec3({},{},{}),".format(*verticies[int(indicies[1]) - 1]), end="")
-        print("vec3({},{},{})".format(*verticies[int(indicies[2]) - 1]), end="")
-        print(", m));\n", end="")
\ No newline at end of file
+print("// GENERATED by obj_to_code.py from " + " ".join(sys.argv[2:]) + ", do not edit")
+print("#ifndef {}_MESH_H".format(name))
+print("#define {}_MESH_H".format(name))
+print()
+print("inline constexpr int {}_TRIANGLE_COUNT = {};".format(name, len(indicies)))
+print()
+print("inline constexpr float {}_VERTICES[] = {{".format(name))
+for v in verticies:
+    print("    {},{},{},".format(*v))
+print("};")
+print()
+print("inline constexpr unsigned short {}_INDICES[] = {{".format(name))
+for i in indicies:
+    print("    {},{},{},".format(*i))
+print("};")
+print()
+print("// material slot per triangle")
+print("inline constexpr unsigned char {}_MATERIALS[] = {{".format(name))
+for i in range(0, len(materials), 32):
+    print("    " + ",".join(str(m) for m in materials[i:i+32]) + ",")
+print("};")
+print()
+print("#endif")
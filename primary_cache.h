@@ -0,0 +1,128 @@
+#ifndef PRIMARY_CACHE_H
+#define PRIMARY_CACHE_H
+
+#include "common.h"
+#include "hittable.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// First hits of the camera rays of a fixed set of sub-pixel positions per pixel. While the camera
+// stands still only the bounces after the first hit change from sample to sample, with the cache a
+// sample takes the hit of one of the positions and starts at the first bounce. The positions are
+// the first PRIMARY_CACHE_POSITIONS points of the jitter sequence of the pixel, so the edges are
+// antialiased with that many stratified samples instead of converging further.
+// Everything is dropped when the camera moves or the scene/image is reset (g_sceneGeneration).
+
+#define PRIMARY_CACHE_POSITIONS 8   // 8 * 12 bytes per pixel on every target, 6 MB at 250x250
+
+#define PRIMARY_EMPTY 0
+#define PRIMARY_MISS 1              // the camera ray hits nothing, the background is seen
+#define PRIMARY_HIT 2
+
+// A first hit as small as it goes: the material is an index into the table of the cache and the
+// normal is octahedral encoded in two 16 bit values (an error of about 1e-4)
+struct PrimaryHit {
+    float t;
+    int16_t normal[2];
+    uint16_t material;
+    uint8_t specialObject;
+    uint8_t state = PRIMARY_EMPTY;
+};
+
+static_assert(sizeof(PrimaryHit) == 12, "PRIMARY_CACHE_POSITIONS is sized for 12 byte hits");
+
+class PrimaryCache {
+public:
+    bool enabled = false;
+
+    // Empties the cache when the camera, the scene or the size of the image changed since the last call
+    void validate(unsigned cameraGeneration, unsigned sceneGeneration, int width, int height) {
+        if (cameraGeneration == camera && sceneGeneration == scene && width == w && height == h)
+            return;
+
+        camera = cameraGeneration;
+        scene = sceneGeneration;
+        w = width;
+        h = height;
+        hits.assign(size_t(width) * height * PRIMARY_CACHE_POSITIONS, PrimaryHit());
+        materials.clear(); // they belong to the scene, which may be gone
+    }
+
+    void release() {
+        hits = std::vector<PrimaryHit>();
+        materials = std::vector<Material*>();
+        camera = scene = ~0u;
+    }
+
+    PrimaryHit& at(int x, int y, int position) {
+        assert(x >= 0 && x < w && y >= 0 && y < h && position >= 0 && position < PRIMARY_CACHE_POSITIONS);
+        return hits[(size_t(y) * w + x) * PRIMARY_CACHE_POSITIONS + position];
+    }
+
+    void store(PrimaryHit& primary, bool found, const hit& rec) {
+        primary.state = found ? PRIMARY_HIT : PRIMARY_MISS;
+        if (!found)
+            return;
+
+        primary.t = rec.t;
+        encodeNormal(rec.normal, primary.normal);
+        primary.material = materialIndex(rec.mat_ptr);
+        primary.specialObject = rec.specialObject;
+    }
+
+    // The evaluated hit of camera ray r as evaluateHit leaves it, as far as shading needs it
+    void load(const PrimaryHit& primary, const Ray& r, hit& rec) const {
+        rec.t = primary.t;
+        rec.point = r.at(primary.t);
+        rec.normal = decodeNormal(primary.normal);
+        rec.mat_ptr = materials[primary.material];
+        rec.specialObject = primary.specialObject;
+    }
+
+private:
+    std::vector<PrimaryHit> hits;
+    std::vector<Material*> materials;
+    unsigned camera = ~0u, scene = ~0u;
+    int w = 0, h = 0;
+
+    uint16_t materialIndex(Material* m) {
+        auto found = std::find(materials.begin(), materials.end(), m);
+        if (found != materials.end())
+            return uint16_t(found - materials.begin());
+        materials.push_back(m);
+        return uint16_t(materials.size() - 1);
+    }
+
+    // The unit normal projected on the octahedron |x| + |y| + |z| = 1, the lower half folded over the upper
+    static void encodeNormal(const vec3& n, int16_t out[2]) {
+        float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        float x = n.x / l1, y = n.y / l1;
+        if (n.z < 0) {
+            float fx = (1 - std::fabs(y)) * (x < 0 ? -1 : 1);
+            float fy = (1 - std::fabs(x)) * (y < 0 ? -1 : 1);
+            x = fx;
+            y = fy;
+        }
+        out[0] = int16_t(std::lround(x * 32767));
+        out[1] = int16_t(std::lround(y * 32767));
+    }
+
+    static vec3 decodeNormal(const int16_t in[2]) {
+        float x = in[0] / 32767.0f, y = in[1] / 32767.0f;
+        float z = 1 - std::fabs(x) - std::fabs(y);
+        if (z < 0) {
+            float fx = (1 - std::fabs(y)) * (x < 0 ? -1 : 1);
+            float fy = (1 - std::fabs(x)) * (y < 0 ? -1 : 1);
+            x = fx;
+            y = fy;
+        }
+        return unitVector(vec3(x, y, z));
+    }
+};
+
+inline PrimaryCache g_primaryCache;
+
+#endif
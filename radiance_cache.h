@@ -0,0 +1,114 @@
+#ifndef RADIANCE_CACHE_H
+#define RADIANCE_CACHE_H
+
+#include "common.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// World space cache of the light that falls on diffuse surfaces. Cells of a spatial hash are keyed
+// by the position and the normal of a hit, every path that leaves a diffuse surface adds what it
+// brought back to the cell of that surface. Once a cell has RADIANCE_CACHE_MIN_SAMPLES a path that
+// already bounced diffusely once stops there and uses the average instead of tracing on: a little
+// blur and bias for a lot less rays. Cells further from the camera are larger, they cover about the
+// same number of pixels.
+
+#define RADIANCE_CACHE_SIZE (1 << 18)    // cells, a power of two
+#define RADIANCE_CACHE_PROBES 8          // linear probing before giving up on a cell
+#define RADIANCE_CACHE_CELL 0.02f        // cell size at distance 1 from the camera
+#define RADIANCE_CACHE_MIN_SAMPLES 16    // before a cell is used
+#define RADIANCE_CACHE_MAX_SAMPLES 1024  // older samples fade out after this, so the cache keeps up
+
+struct RadianceCacheCell {
+    uint32_t key = 0; // 0 is empty
+    float count = 0;
+    vec3 sum;
+};
+
+class RadianceCache {
+public:
+    bool enabled = false;
+
+    // The cells are only allocated while the cache is in use (RADIANCE_CACHE_SIZE * 20 bytes)
+    void allocate() {
+        cells.assign(RADIANCE_CACHE_SIZE, RadianceCacheCell());
+    }
+
+    void release() {
+        cells = std::vector<RadianceCacheCell>();
+    }
+
+    void clear() {
+        std::fill(cells.begin(), cells.end(), RadianceCacheCell());
+    }
+
+    // Average incident radiance at point, false when its cell has too few samples
+    bool lookup(const vec3& point, const vec3& normal, const vec3& camera, vec3& radiance) const {
+        uint32_t key = hashKey(point, normal, camera);
+        for (int i = 0; i < RADIANCE_CACHE_PROBES; i++) {
+            const RadianceCacheCell& cell = cells[(key + i) & (RADIANCE_CACHE_SIZE - 1)];
+            if (cell.key == key) {
+                if (cell.count < RADIANCE_CACHE_MIN_SAMPLES)
+                    return false;
+                radiance = cell.sum / cell.count;
+                return true;
+            }
+            if (cell.key == 0)
+                return false;
+        }
+        return false;
+    }
+
+    void add(const vec3& point, const vec3& normal, const vec3& camera, const vec3& radiance) {
+        uint32_t key = hashKey(point, normal, camera);
+        for (int i = 0; i < RADIANCE_CACHE_PROBES; i++) {
+            RadianceCacheCell& cell = cells[(key + i) & (RADIANCE_CACHE_SIZE - 1)];
+            if (cell.key != key && cell.key != 0)
+                continue;
+
+            if (cell.count >= RADIANCE_CACHE_MAX_SAMPLES) {
+                cell.sum *= (RADIANCE_CACHE_MAX_SAMPLES - 1) / cell.count;
+                cell.count = RADIANCE_CACHE_MAX_SAMPLES - 1;
+            }
+            cell.key = key;
+            cell.sum += radiance;
+            cell.count += 1;
+            return;
+        }
+        // the neighbourhood is full, this sample is dropped
+    }
+
+private:
+    std::vector<RadianceCacheCell> cells;
+
+    static uint32_t hashKey(const vec3& point, const vec3& normal, const vec3& camera) {
+        // the level of detail: cell sizes double with every doubling of the distance
+        int level = std::max(0, int(std::ceil(std::log2((point - camera).length() + 1.0f))));
+        float size = RADIANCE_CACHE_CELL * float(1 << level);
+
+        uint32_t h = hash(uint32_t(level));
+        h = hash(h ^ uint32_t(int32_t(std::floor(point.x / size))));
+        h = hash(h ^ uint32_t(int32_t(std::floor(point.y / size))));
+        h = hash(h ^ uint32_t(int32_t(std::floor(point.z / size))));
+
+        // the normal in 5x5x5 bins, both sides of a thin object are different cells
+        uint32_t n = uint32_t(std::clamp(int((normal.x + 1) * 2.5f), 0, 4))
+                   + uint32_t(std::clamp(int((normal.y + 1) * 2.5f), 0, 4)) * 5
+                   + uint32_t(std::clamp(int((normal.z + 1) * 2.5f), 0, 4)) * 25;
+        return hash(h ^ n) | 1;
+    }
+
+    static uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352d;
+        x ^= x >> 15;
+        x *= 0x846ca68b;
+        x ^= x >> 16;
+        return x;
+    }
+};
+
+inline RadianceCache g_radianceCache;
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include "renderer.h"
+
+#include <coroutine>
+#include <utility>
+
+// A full frame render (the same work as render()) that can be spread over many short slices.
+// step(n) runs the job until n more rays are traced and returns, the next step() continues at the
+// exact pixel it stopped. The job stops by itself when the scene changes (loadWorld, clear, ...)
+// so a stale frame never wastes a slice. Needs C++20.
+class RenderJob {
+public:
+    struct promise_type {
+        int budget = 0;   // rays left in the current slice
+
+        // co_yield n: spends n rays, suspends once the slice is used up
+        struct Slice {
+            bool suspend;
+            bool await_ready() const noexcept { return !suspend; }
+            void await_suspend(std::coroutine_handle<>) const noexcept {}
+            void await_resume() const noexcept {}
+        };
+
+        RenderJob get_return_object() { return RenderJob(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        Slice yield_value(int rays) noexcept {
+            budget -= rays;
+            return Slice{ budget <= 0 };
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    RenderJob() {}
+    RenderJob(RenderJob&& other) noexcept : handle(std::exchange(other.handle, nullptr)), generation(other.generation) {}
+    RenderJob& operator=(RenderJob&& other) noexcept {
+        if (this != &other) {
+            cancel();
+            handle = std::exchange(other.handle, nullptr);
+            generation = other.generation;
+        }
+        return *this;
+    }
+    ~RenderJob() { cancel(); }
+
+    // Traces up to `rays` rays, returns true while there is work left
+    bool step(int rays) {
+        if (!handle)
+            return false;
+
+        if (generation != g_sceneGeneration || handle.done()) {
+            cancel();
+            return false;
+        }
+
+        handle.promise().budget = rays;
+        handle.resume();
+
+        if (handle.done()) {
+            cancel();
+            return false;
+        }
+        return true;
+    }
+
+    bool running() const { return bool(handle); }
+
+    void cancel() {
+        if (handle)
+            handle.destroy();
+        handle = nullptr;
+    }
+
+private:
+    explicit RenderJob(std::coroutine_handle<promise_type> h) : handle(h), generation(g_sceneGeneration) {}
+
+    std::coroutine_handle<promise_type> handle = nullptr;
+    unsigned generation = 0;
+};
+
+inline RenderJob renderJob() {
+    for (int y = 0; y < g_height; y++) {
+        for (int x = 0; x < g_width; x++) {
+            renderPixel(x, y);
+            co_yield 1;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,442 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "common.h"
+#include "hittable.h"
+#include "camera.h"
+#include "material.h"
+#include "worlds.h"
+#include "sampler.h"
+#include "radiance_cache.h"
+#include "primary_cache.h"
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define INF 999999.9
+#define COLOR_CHANNELS 3
+#define IMAGE_WIDTH 250
+#define IMAGE_HEIGHT 250
+#define BUFFER_CHANNELS 4
+
+// What a sample writes into the image: its colour or one of the costs of tracing it as a heatmap
+#define RENDER_COLOR 0
+#define RENDER_TESTS 1      // primitive intersection tests
+#define RENDER_STEPS 2      // BVH and scene graph nodes visited
+#define RENDER_BOUNCES 3
+#define RENDER_TIME 4       // nanoseconds
+
+
+// EM_JS(void, __draw, (int x, int y, int r, int g, int b), {
+//     ctx.fillStyle = "rgb("+r+","+g+","+b+")";
+//     ctx.fillRect(x, y, 1, 1); 
+// });
+
+// inline void draw (int x, int y, vec3 color) {
+//     __draw(x,y, static_cast<int>(color.r * 255.99), static_cast<int>(color.g * 255.99), static_cast<int>(color.b * 255.99));
+// }
+
+
+inline int g_width = IMAGE_WIDTH;
+inline int g_height = IMAGE_HEIGHT;
+
+inline std::vector<float> data(IMAGE_WIDTH * IMAGE_HEIGHT * COLOR_CHANNELS, 0.0f);
+inline std::vector<float> rayCounter(IMAGE_WIDTH * IMAGE_HEIGHT, 0.0f); // int counter that is used to devide
+
+inline std::vector<unsigned char> byteBuffer(IMAGE_WIDTH * IMAGE_HEIGHT * BUFFER_CHANNELS, 0x00);
+
+// bumped whenever the scene or the image is reset, running render jobs stop when it changes
+inline unsigned g_sceneGeneration = 0;
+
+inline void draw (int x, int y, const vec3 color) {
+    int index = (y*g_width + x);
+    data[index * COLOR_CHANNELS + 0] += color.r;
+    data[index * COLOR_CHANNELS + 1] += color.g;
+    data[index * COLOR_CHANNELS + 2] += color.b;
+    rayCounter[index] += 1.0f;
+
+    byteBuffer[index * BUFFER_CHANNELS + 0] = static_cast<unsigned char>((data[index * COLOR_CHANNELS + 0] / rayCounter[index]) * 255.0f);
+    byteBuffer[index * BUFFER_CHANNELS + 1] = static_cast<unsigned char>((data[index * COLOR_CHANNELS + 1] / rayCounter[index]) * 255.0f);
+    byteBuffer[index * BUFFER_CHANNELS + 2] = static_cast<unsigned char>((data[index * COLOR_CHANNELS + 2] / rayCounter[index]) * 255.0f);
+    byteBuffer[index * BUFFER_CHANNELS + 3] = 0xff;
+}
+
+inline void clear() {
+    std::fill(data.begin(), data.end(), 0.0f);
+    std::fill(rayCounter.begin(), rayCounter.end(), 0.0f);
+    std::fill(byteBuffer.begin(), byteBuffer.end(), 0x00);
+    g_sceneGeneration++;
+}
+
+inline int g_level = 0;
+inline Arena g_arena; // owns everything in g_world
+inline HittableList* g_world = compileScene(g_arena, world1(g_arena)); // world, flattened
+inline Camera g_camera(vec3(-4,-10,1), vec3(-2,0,5), vec3(0,0,1));
+inline vec3 g_background = vec3(0, 0, 0);
+
+inline int g_renderMode = RENDER_COLOR;
+inline float g_heatmapScale = 0; // cost that is drawn red, 0 for the default of the mode
+
+inline void loadWorld(int level) {
+    g_level = level;
+    g_sceneGeneration++;
+    g_radianceCache.clear();
+
+    switch (g_level) {
+        case 1:
+            g_camera.setPosition(vec3(0,-2,-2));
+            g_camera.setLookat(vec3(0,0,-1));
+            g_background = vec3(0.4,0.4,1.0);
+            g_arena.reset();
+            g_world = compileScene(g_arena, world1(g_arena));
+            break;
+        case 2:
+            g_camera.setPosition(vec3(-4,-10,1));
+            g_camera.setLookat(vec3(-2,0,5));
+            g_background = vec3(1,1,1);
+            g_arena.reset();
+            g_world = compileScene(g_arena, world2(g_arena));
+            break;
+        case 3:
+            g_camera.setPosition(vec3(0,0.01,-17));
+            g_camera.setLookat(vec3(0,0,0));
+            g_background = vec3(0.1, 0.08, 0.15);
+            g_arena.reset();
+            g_world = compileScene(g_arena, world3(g_arena));
+            break;
+    }
+
+    std::cout << "Loaded level " << g_level << " (" << g_world->size() << " primitives, " << g_arena.allocationCount() << " allocations, "
+              << g_arena.bytesAllocated() << " bytes)" << std::endl;
+}
+
+// Changes the size of the accumulation buffers, this clears the image
+inline void setResolution(int width, int height) {
+    g_width = width;
+    g_height = height;
+
+    data.assign(width * height * COLOR_CHANNELS, 0.0f);
+    rayCounter.assign(width * height, 0.0f);
+    byteBuffer.assign(width * height * BUFFER_CHANNELS, 0x00);
+    g_sceneGeneration++;
+
+    g_camera.setAspectRatio(float(width) / float(height));
+}
+
+// Switches between the colour and heatmap renders, clears the image
+inline void setRenderMode(int mode, float scale) {
+    g_renderMode = mode;
+    g_heatmapScale = scale;
+    clear();
+}
+
+// Lets paths end in the radiance cache after their first diffuse bounce, starts it empty and clears the image
+inline void setRadianceCache(bool enabled) {
+    g_radianceCache.enabled = enabled;
+    if (enabled)
+        g_radianceCache.allocate();
+    else
+        g_radianceCache.release();
+    clear();
+}
+
+// Lets camera samples start at cached first hits while the camera stands still, clears the image
+inline void setPrimaryCache(bool enabled) {
+    g_primaryCache.enabled = enabled;
+    if (!enabled)
+        g_primaryCache.release();
+    clear();
+}
+
+// False colour ramp: 0 black, then blue, green, yellow and red at 1, white above
+inline vec3 heatColor(float t) {
+    if (t > 1)
+        return vec3(1,1,1);
+
+    const vec3 ramp[] = { vec3(0,0,0), vec3(0,0,1), vec3(0,1,0), vec3(1,1,0), vec3(1,0,0) };
+    float f = fmax(t, 0.0f) * 4;
+    int i = std::min(int(f), 3);
+    return ramp[i] + (f - i) * (ramp[i + 1] - ramp[i]);
+}
+
+inline vec3 shade(const Ray& r, const hit& rec, const Hittable& hittable, int depth, Sampler& sampler, bool afterDiffuse);
+
+// afterDiffuse: the path already bounced off a diffuse surface, so it may end in the radiance cache
+inline vec3 trace(const Ray& r, const Hittable& hittable, int depth, Sampler& sampler, bool afterDiffuse = false) {
+    hit rec; 
+
+    // end of recursive ray bounces
+    if (depth <= 0) 
+        return vec3(0,0,0);
+
+    // if the ray hits nothing
+    if (!hittable.trace(r, 0.001, INF, rec))
+        return g_background;
+
+    evaluateHit(r, rec);
+
+    return shade(r, rec, hittable, depth, sampler, afterDiffuse);
+}
+
+// Emitted light plus what the scattered ray brings back, the part of trace() after the hit
+inline vec3 shade(const Ray& r, const hit& rec, const Hittable& hittable, int depth, Sampler& sampler, bool afterDiffuse) {
+    Ray scattered;
+    vec3 albedo;
+    vec3 emitted = rec.mat_ptr->emitted();
+
+    sampler.startBounce();
+    if (!rec.mat_ptr->scatter(r, rec, albedo, scattered, sampler))
+        return emitted;
+
+    bool cached = g_radianceCache.enabled && rec.mat_ptr->diffuse();
+    vec3 incident;
+    if (cached && afterDiffuse && g_radianceCache.lookup(rec.point, rec.normal, g_camera.position(), incident))
+        return emitted + albedo * incident;
+
+    g_traceCost.bounces++;
+
+    auto tr = trace(scattered, hittable, depth-1, sampler, afterDiffuse || cached);
+
+    if (cached)
+        g_radianceCache.add(rec.point, rec.normal, g_camera.position(), tr);
+
+    return emitted + albedo * tr;
+}
+
+// trace() of a camera ray whose first hit is taken from (or stored in) primary when there is one
+inline vec3 tracePrimary(const Ray& r, int depth, Sampler& sampler, PrimaryHit* primary) {
+    if (primary == nullptr)
+        return trace(r, *g_world, depth, sampler);
+
+    if (depth <= 0)
+        return vec3(0,0,0);
+
+    hit rec;
+    if (primary->state == PRIMARY_EMPTY) {
+        bool found = g_world->trace(r, 0.001, INF, rec);
+        if (found)
+            evaluateHit(r, rec);
+        g_primaryCache.store(*primary, found, rec);
+    } else if (primary->state == PRIMARY_HIT) {
+        g_primaryCache.load(*primary, r, rec);
+    }
+
+    if (primary->state == PRIMARY_MISS)
+        return g_background;
+
+    return shade(r, rec, *g_world, depth, sampler, false);
+}
+
+// Traces a camera ray, in a heatmap mode it returns the colour of what that cost
+inline vec3 renderSample(const Ray& r, int depth, Sampler& sampler, PrimaryHit* primary = nullptr) {
+    if (g_renderMode == RENDER_COLOR)
+        return tracePrimary(r, depth, sampler, primary);
+
+    g_traceCost = TraceCost();
+    auto start = std::chrono::steady_clock::now();
+    tracePrimary(r, depth, sampler, primary);
+    float ns = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    float value = 0, scale = 1;
+    switch (g_renderMode) {
+        case RENDER_TESTS:   value = g_traceCost.tests;   scale = 512;   break;
+        case RENDER_STEPS:   value = g_traceCost.steps;   scale = 64;    break;
+        case RENDER_BOUNCES: value = g_traceCost.bounces; scale = depth; break;
+        case RENDER_TIME:    value = ns;                  scale = 20000; break;
+    }
+
+    return heatColor(value / (g_heatmapScale > 0 ? g_heatmapScale : scale));
+}
+
+// Camera ray through sub-pixel position `position` of pixel (x, y), the jitter of that sample of its sequence
+inline Ray primaryRay(int x, int y, int position) {
+    Sampler sampler;
+    sampler.startPixel(x, y, uint32_t(position));
+
+    float jx, jy;
+    sampler.get2D(jx, jy);
+    return g_camera.getRay((float(x) + jx) / float(g_width-1), (float(y) + jy) / float(g_height-1));
+}
+
+inline void validatePrimaryCache() {
+    if (g_primaryCache.enabled)
+        g_primaryCache.validate(g_camera.generation(), g_sceneGeneration, g_width, g_height);
+}
+
+// Traces the disc of sendRay and hands every sample to splat(x, y, color). Only every stride-th point
+// of the disc is traced, starting at first, so threads can split one disc between them.
+template<class Splat>
+void traceDisc(float u, float v, float radius, int first, int stride, Splat&& splat) {
+    Sampler sampler;
+    int cx = int(u * float(g_width));
+    int cy = int(v * float(g_height));
+    int point = 0;
+
+    for (int rx=-radius; rx<=radius; rx++) {
+        for (int ry=-radius; ry<=radius; ry++) {
+            if (sqrt(rx*rx + ry*ry) > radius)
+                continue;
+            if (point++ % stride != first)
+                continue;
+
+            // the sequence of the pixel the ray lands in (give or take the jitter)
+            int px = std::clamp(cx + rx, 0, g_width - 1);
+            int py = std::clamp(cy + ry, 0, g_height - 1);
+            uint32_t index = uint32_t(rayCounter[py*g_width + px]);
+            sampler.startPixel(px, py, index);
+
+            float jx, jy;
+            sampler.get2D(jx, jy);
+            float u2 = u + (rx + jx) / float(g_width);
+            float v2 = v + (ry + jy) / float(g_height);
+
+            Ray r = g_camera.getRay(u2, v2);
+
+            int x = int(u2 * float(g_width));
+            int y = int(v2 * float(g_height));
+
+            if (x < 0 || x >= g_width || y < 0 || y >= g_height)
+                continue;
+
+            int depth = 3 + int(rayCounter[y*g_width + x] / 5.0f);
+            if (g_primaryCache.enabled) {
+                // snapped to a cached position of the pixel it lands in
+                int position = int(index % PRIMARY_CACHE_POSITIONS);
+                splat(x, y, renderSample(primaryRay(x, y, position), depth, sampler, &g_primaryCache.at(x, y, position)));
+            } else {
+                splat(x, y, renderSample(r, depth, sampler));
+            }
+        }
+    }
+}
+
+inline void sendRay(float u, float v, float radius) {
+    validatePrimaryCache();
+    traceDisc(u, v, radius, 0, 1, draw);
+}
+
+// Samples of one thread for anywhere in the image, kept out of data/rayCounter until resolve().
+// Threads that splat into their own buffer share nothing while they trace, so they need no locks.
+class SplatBuffer {
+public:
+    void add(int x, int y, const vec3& color) {
+        splats.push_back({ x, y, color });
+    }
+
+    // Adds the samples in rows [y0, y1) to the image
+    void resolve(int y0, int y1) const {
+        for (const Splat& s : splats) {
+            if (s.y >= y0 && s.y < y1)
+                draw(s.x, s.y, s.color);
+        }
+    }
+
+private:
+    struct Splat {
+        int x, y;
+        vec3 color;
+    };
+    std::vector<Splat> splats;
+};
+
+// sendRay split over `threads` threads: each traces every threads-th point of the disc into its own
+// SplatBuffer, so a click is the same samples whatever the thread count. Once all are done every
+// thread adds a band of rows of all buffers to the image, in buffer order. Samples of one click see
+// the counts from before the click, unlike sendRay. The radiance and primary hit caches and drand48
+// (RandomSampler) are shared state, with any of them this is sendRay. The wasm build needs -pthread.
+inline void sendRays(float u, float v, float radius, int threads) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    threads = 1;
+#endif
+    if (g_radianceCache.enabled || g_primaryCache.enabled || std::is_same_v<Sampler, RandomSampler>)
+        threads = 1;
+
+    if (threads <= 1) {
+        sendRay(u, v, radius);
+        return;
+    }
+
+    std::vector<SplatBuffer> buffers(threads);
+    std::barrier traced(threads);
+    auto work = [&](int t) {
+        traceDisc(u, v, radius, t, threads, [&](int x, int y, const vec3& color) { buffers[t].add(x, y, color); });
+        traced.arrive_and_wait();
+
+        int y0 = g_height * t / threads;
+        int y1 = g_height * (t + 1) / threads;
+        for (const auto& buffer : buffers)
+            buffer.resolve(y0, y1);
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.emplace_back(work, t);
+    work(0);
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+// One jittered sample for pixel (x, y), the number of samples it already has picks the sample of its sequence
+inline void renderPixel(int x, int y) {
+    validatePrimaryCache(); // render jobs get here without renderTile, the camera may move between their steps
+    Sampler sampler;
+    sampler.startPixel(x, y, uint32_t(rayCounter[y*g_width + x]));
+
+    float jx, jy;
+    sampler.get2D(jx, jy); // taken either way, so the bounces use the same slots
+
+    if (g_primaryCache.enabled) {
+        int position = int(rayCounter[y*g_width + x]) % PRIMARY_CACHE_POSITIONS;
+        draw(x, y, renderSample(primaryRay(x, y, position), 4, sampler, &g_primaryCache.at(x, y, position)));
+        return;
+    }
+
+    auto u = (float(x) + jx) / float(g_width-1);
+    auto v = (float(y) + jy) / float(g_height-1);
+    Ray r = g_camera.getRay(u, v);
+    draw(x, y, renderSample(r, 4, sampler));
+}
+
+// One sample for every pixel in [x0, x1) x [y0, y1)
+inline void renderTile(int x0, int y0, int x1, int y1) {
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            renderPixel(x, y);
+        }
+    }
+}
+
+inline void render() {
+    renderTile(0, 0, g_width, g_height);
+}
+
+inline void renderAt(int x, int y, int z) { // tmp
+    clear();
+    g_camera.setPosition(vec3(x,y,z));
+    render();
+}
+
+inline bool raycast(float x, float y) {
+    Ray r = g_camera.getRay(x, y);
+    hit rec;
+    if (g_world->trace(r, 0.001, INF, rec)) {
+        evaluateHit(r, rec);
+        if (rec.specialObject) {
+             std::cout << "YHEEE" << std::endl;
+            return true;
+        } else {
+            std::cout << "NOOOO" << std::endl;
+        }
+    } else {
+        std::cout << "NO hit" << std::endl;
+    }
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "common.h"
+
+#include <cstdint>
+
+// Where the random numbers of a path come from. A path asks for its numbers in a fixed order of
+// "slots": slot 0 jitters the pixel, every bounce then owns SAMPLER_SLOTS_PER_BOUNCE slots no matter
+// how many of them its material uses, so the same slot always means the same thing.
+//
+//   sampler.startPixel(x, y, sampleIndex);  // before the camera ray
+//   sampler.get2D(u, v);                     // pixel jitter
+//   sampler.startBounce();                   // before every Material::scatter
+//
+// Both samplers have the same interface, pick one with -DSAMPLER=RandomSampler to compare.
+
+#define SAMPLER_SLOTS_PER_BOUNCE 2
+
+#ifndef SAMPLER
+#define SAMPLER SobolSampler
+#endif
+
+inline uint32_t g_samplerSeed = 0; // changes the pattern of the whole image
+
+// Independent uniform numbers from drand48, how the renderer always worked
+class RandomSampler {
+public:
+    void startPixel(int x, int y, uint32_t sampleIndex) {}
+    void startBounce() {}
+
+    float get1D() { return MATH::random(); }
+    void get2D(float& u, float& v) {
+        u = MATH::random();
+        v = MATH::random();
+    }
+};
+
+namespace SOBOL
+{
+    inline uint32_t reverseBits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+        x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+        x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+        x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+        return x;
+    }
+
+    inline uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352d;
+        x ^= x >> 15;
+        x *= 0x846ca68b;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // The first two dimensions of the Sobol sequence, a (0,2)-sequence: every power of two prefix
+    // is stratified in both dimensions at once. Dimension 0 is the van der Corput sequence.
+    inline void sobol2D(uint32_t index, uint32_t& x, uint32_t& y) {
+        x = reverseBits(index);
+        y = 0;
+        for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+            if (index & 1)
+                y ^= v;
+        }
+    }
+
+    // Owen scrambling as a hash (Laine-Karras): every bit is flipped depending on the bits above it,
+    // which keeps the stratification of the points but randomizes them per seed
+    inline uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+        x ^= x * 0x3d20adea;
+        x += seed;
+        x *= (seed >> 16) | 1;
+        x ^= x * 0x05526c56;
+        x ^= x * 0x53a22864;
+        return x;
+    }
+
+    inline uint32_t owenScramble(uint32_t x, uint32_t seed) {
+        return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+    }
+
+    inline float toFloat(uint32_t x) {
+        return float(x >> 8) * (1.0f / 16777216.0f); // 24 bits, never 1
+    }
+}
+
+// Owen scrambled 2D Sobol points, padded: every slot shuffles the sample index with its own seed so
+// the slots are independent of each other, and the seed of a pixel decorrelates neighbouring pixels.
+// sampleIndex has to count up per pixel (0, 1, 2, ...) for the points to stay stratified.
+class SobolSampler {
+public:
+    void startPixel(int x, int y, uint32_t sampleIndex) {
+        pixelSeed = SOBOL::hash(uint32_t(x) * 0x9e3779b9 ^ SOBOL::hash(uint32_t(y) ^ g_samplerSeed));
+        index = sampleIndex;
+        slot = 0;
+        bounce = 0;
+    }
+
+    void startBounce() {
+        slot = 1 + bounce * SAMPLER_SLOTS_PER_BOUNCE;
+        bounce++;
+    }
+
+    float get1D() {
+        float u, v;
+        get2D(u, v);
+        return u;
+    }
+
+    void get2D(float& u, float& v) {
+        uint32_t seed = SOBOL::hash(pixelSeed ^ SOBOL::hash(slot++));
+        uint32_t shuffled = SOBOL::owenScramble(index, seed);
+
+        uint32_t x, y;
+        SOBOL::sobol2D(shuffled, x, y);
+        u = SOBOL::toFloat(SOBOL::owenScramble(x, SOBOL::hash(seed + 1)));
+        v = SOBOL::toFloat(SOBOL::owenScramble(y, SOBOL::hash(seed + 2)));
+    }
+
+private:
+    uint32_t pixelSeed = 0;
+    uint32_t index = 0;
+    uint32_t slot = 0;
+    uint32_t bounce = 0;
+};
+
+using Sampler = SAMPLER;
+
+#endif
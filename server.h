@@ -0,0 +1,359 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "renderer.h"
+#include "checkpoint.h"
+#include "farm.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Headless rendering for thin clients. The server owns the scene and the accumulation buffers and
+// renders pass after pass, a client sends commands (level, camera, pick, sendRay) and gets back frames
+// that only hold the SERVER_TILE tiles of byteBuffer that changed since its previous frame.
+//
+// A changed tile is sent as the bytewise difference to what the client already has, run length
+// encoded: a converging image changes a few values by 1 here and there, a camera move changes all.
+// The server listens on the loopback interface only, a remote client needs a tunnel (ssh -L).
+//
+//   ./cli serve --level 2 --spp 256 &
+//   ./cli client --level 2 --spp 256 --out level2.ppm
+
+#define SERVER_PORT 5151
+#define SERVER_TILE 32
+
+#define COMMAND_QUIT 0          // ends the session of this client
+#define COMMAND_SHUTDOWN 1      // stops the server
+#define COMMAND_LEVEL 2         // args: level
+#define COMMAND_CAMERA 3        // args: from x, y, z, at x, y, z
+#define COMMAND_PICK 4          // args: x, y in [0, 1], the answer is in FrameHeader::picked
+#define COMMAND_RAY 5           // args: u, v, radius, see sendRay
+
+struct ServerCommand {
+    int32_t type;
+    uint32_t sequence;      // echoed in the frames, so the client knows when its command is in the image
+    float args[6];
+};
+
+struct FrameHeader {
+    uint32_t frame;
+    uint32_t lastCommand;   // sequence of the last command applied before this frame
+    int32_t width, height;
+    int32_t picked;         // answer to the last pick: 1 special object, 0 anything else, -1 none yet
+    uint32_t samples;       // passes in the image since the last reset
+    int32_t done;           // 1 when the server waits for a command before it renders again
+    uint32_t tiles;         // TileHeaders with their encoded bytes follow
+};
+
+struct TileHeader {
+    int32_t x0, y0, x1, y1;
+    uint32_t bytes;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////// RLE
+
+// PackBits: a control byte n < 128 is followed by n + 1 literal bytes, n > 128 by one byte that
+// repeats 257 - n times
+inline void rleEncode(const uint8_t* in, size_t count, std::vector<uint8_t>& out) {
+    size_t i = 0;
+    while (i < count) {
+        size_t run = 1;
+        while (i + run < count && run < 128 && in[i + run] == in[i])
+            run++;
+
+        if (run >= 2) {
+            out.push_back(uint8_t(257 - run));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+
+        // literals until the next run of at least 3
+        size_t literal = 1;
+        while (i + literal < count && literal < 128) {
+            if (i + literal + 2 < count && in[i + literal] == in[i + literal + 1] && in[i + literal] == in[i + literal + 2])
+                break;
+            literal++;
+        }
+        out.push_back(uint8_t(literal - 1));
+        out.insert(out.end(), in + i, in + i + literal);
+        i += literal;
+    }
+}
+
+// Returns false when the input does not decode to exactly count bytes
+inline bool rleDecode(const uint8_t* in, size_t bytes, uint8_t* out, size_t count) {
+    size_t i = 0, o = 0;
+    while (i < bytes) {
+        uint8_t n = in[i++];
+        if (n < 128) {
+            if (i + n + 1 > bytes || o + n + 1 > count)
+                return false;
+            std::copy(in + i, in + i + n + 1, out + o);
+            i += n + 1;
+            o += n + 1;
+        } else if (n > 128) {
+            if (i >= bytes || o + 257 - n > count)
+                return false;
+            std::fill(out + o, out + o + 257 - n, in[i++]);
+            o += 257 - n;
+        }
+    }
+    return o == count;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////// SERVER
+
+struct ServerStats {
+    uint32_t frames = 0;
+    double bytesSent = 0;
+    double tilesSent = 0;
+};
+
+// Applies a command to the scene, returns false for quit and shutdown
+inline bool applyCommand(const ServerCommand& command, int& picked) {
+    const float* a = command.args;
+    switch (command.type) {
+        case COMMAND_LEVEL:
+            loadWorld(int(a[0]));
+            clear();
+            return true;
+        case COMMAND_CAMERA:
+            g_camera.setPosition(vec3(a[0], a[1], a[2]));
+            g_camera.setLookat(vec3(a[3], a[4], a[5]));
+            clear();
+            return true;
+        case COMMAND_PICK:
+            picked = raycast(a[0], a[1]) ? 1 : 0;
+            return true;
+        case COMMAND_RAY:
+            sendRay(a[0], a[1], a[2]);
+            return true;
+    }
+    return false;
+}
+
+// Changed tiles of byteBuffer against what the client has (sent), which is updated to match
+inline void encodeFrame(std::vector<uint8_t>& sent, std::vector<uint8_t>& message, uint32_t& tiles) {
+    std::vector<uint8_t> delta;
+    tiles = 0;
+
+    for (int y0 = 0; y0 < g_height; y0 += SERVER_TILE) {
+        for (int x0 = 0; x0 < g_width; x0 += SERVER_TILE) {
+            TileHeader tile = { x0, y0, std::min(x0 + SERVER_TILE, g_width), std::min(y0 + SERVER_TILE, g_height), 0 };
+
+            delta.clear();
+            bool changed = false;
+            for (int y = tile.y0; y < tile.y1; y++) {
+                size_t begin = size_t(y * g_width + tile.x0) * BUFFER_CHANNELS;
+                size_t end = size_t(y * g_width + tile.x1) * BUFFER_CHANNELS;
+                for (size_t i = begin; i < end; i++) {
+                    uint8_t d = uint8_t(byteBuffer[i] - sent[i]);
+                    changed = changed || d != 0;
+                    delta.push_back(d);
+                    sent[i] = byteBuffer[i];
+                }
+            }
+            if (!changed)
+                continue;
+
+            size_t at = message.size();
+            message.resize(at + sizeof(TileHeader));
+            rleEncode(delta.data(), delta.size(), message);
+            tile.bytes = uint32_t(message.size() - at - sizeof(TileHeader));
+            std::copy_n(reinterpret_cast<const uint8_t*>(&tile), sizeof(tile), message.begin() + at);
+            tiles++;
+        }
+    }
+}
+
+// Serves one client until it quits or goes away, returns false when it asked for a shutdown
+inline bool serveClient(int fd, int maxSamples, ServerStats& stats) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    std::vector<uint8_t> sent(byteBuffer.size(), 0);    // the image of the client
+    std::vector<uint8_t> message;
+    uint32_t lastCommand = 0;
+    int picked = -1;
+    int samples = 0;
+    unsigned generation = g_sceneGeneration;
+
+    while (true) {
+        // take every command that is waiting, block for one when the image is done
+        bool commanded = false;
+        pollfd p = { fd, POLLIN, 0 };
+        while (poll(&p, 1, samples < maxSamples || commanded ? 0 : -1) > 0) {
+            ServerCommand command;
+            if (!readAll(fd, &command, sizeof(command)))
+                return true;
+            if (!applyCommand(command, picked))
+                return command.type != COMMAND_SHUTDOWN;
+            lastCommand = command.sequence;
+            commanded = true;
+        }
+
+        if (g_sceneGeneration != generation) {
+            generation = g_sceneGeneration;
+            samples = 0;
+        }
+
+        if (samples < maxSamples) {
+            render();
+            samples++;
+        }
+
+        FrameHeader header = { stats.frames, lastCommand, g_width, g_height, picked, uint32_t(samples), samples >= maxSamples, 0 };
+        message.assign(sizeof(header), 0);
+        encodeFrame(sent, message, header.tiles);
+        std::copy_n(reinterpret_cast<const uint8_t*>(&header), sizeof(header), message.begin());
+
+        if (!writeAll(fd, message.data(), message.size()))
+            return true;
+
+        stats.frames++;
+        stats.bytesSent += message.size();
+        stats.tilesSent += header.tiles;
+    }
+}
+
+// Renders for one client after the other on the loopback interface until one sends a shutdown
+inline bool runServer(const CheckpointHeader& settings, int port, int maxSamples) {
+    signal(SIGPIPE, SIG_IGN);
+    applyRenderSettings(settings);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        close(listener);
+        return false;
+    }
+
+    printf("Serving on 127.0.0.1:%d\n", port);
+    fflush(stdout);
+
+    bool running = true;
+    while (running) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        ServerStats stats;
+        running = serveClient(fd, maxSamples, stats);
+        close(fd);
+
+        printf("Client done: %u frames, %.0f tiles, %.2f MB sent\n", stats.frames, stats.tilesSent, stats.bytesSent / 1e6);
+        fflush(stdout);
+    }
+
+    close(listener);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////// CLIENT
+
+// The other end: sends commands and keeps its own copy of the image up to date with the frames
+class RenderClient {
+public:
+    std::vector<uint8_t> image;     // RGBA like byteBuffer
+    FrameHeader last = {};
+    double bytesReceived = 0;
+
+    ~RenderClient() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool connectTo(int port) {
+        signal(SIGPIPE, SIG_IGN);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(uint16_t(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    }
+
+    // Returns the sequence number of the command, 0 when it could not be sent
+    uint32_t send(int32_t type, std::initializer_list<float> args = {}) {
+        ServerCommand command = { type, ++sequence, {} };
+        std::copy(args.begin(), args.begin() + std::min<size_t>(args.size(), 6), command.args);
+        return writeAll(fd, &command, sizeof(command)) ? command.sequence : 0;
+    }
+
+    // Waits for the next frame and applies its tiles to image
+    bool receive() {
+        FrameHeader header;
+        if (!readAll(fd, &header, sizeof(header)))
+            return false;
+
+        if (image.size() != size_t(header.width * header.height * BUFFER_CHANNELS))
+            image.assign(header.width * header.height * BUFFER_CHANNELS, 0);
+
+        std::vector<uint8_t> delta;
+        for (uint32_t t = 0; t < header.tiles; t++) {
+            TileHeader tile;
+            if (!readAll(fd, &tile, sizeof(tile)))
+                return false;
+            encoded.resize(tile.bytes);
+            if (!readAll(fd, encoded.data(), encoded.size()))
+                return false;
+
+            if (tile.x0 < 0 || tile.y0 < 0 || tile.x1 > header.width || tile.y1 > header.height || tile.x0 >= tile.x1 || tile.y0 >= tile.y1)
+                return false;
+
+            int rowBytes = (tile.x1 - tile.x0) * BUFFER_CHANNELS;
+            delta.resize(rowBytes * (tile.y1 - tile.y0));
+            if (!rleDecode(encoded.data(), encoded.size(), delta.data(), delta.size()))
+                return false;
+
+            for (int y = tile.y0; y < tile.y1; y++) {
+                uint8_t* row = &image[size_t(y * header.width + tile.x0) * BUFFER_CHANNELS];
+                for (int i = 0; i < rowBytes; i++)
+                    row[i] += delta[(y - tile.y0) * rowBytes + i];
+            }
+
+            bytesReceived += sizeof(tile) + tile.bytes;
+        }
+
+        bytesReceived += sizeof(header);
+        last = header;
+        return true;
+    }
+
+private:
+    int fd = -1;
+    uint32_t sequence = 0;
+    std::vector<uint8_t> encoded;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef TRACE_COST_H
+#define TRACE_COST_H
+
+#include <cstdint>
+
+// Work done by trace() calls, counted by the primitives and acceleration structures themselves.
+// Cheap enough to always count, the heatmap render modes in renderer.h read it per pixel.
+// Every thread counts its own work.
+struct TraceCost {
+    uint32_t tests = 0;     // primitive intersection tests
+    uint32_t steps = 0;     // BVH nodes and scene graph nodes (lists, transforms) visited
+    uint32_t bounces = 0;   // scattered rays
+};
+
+inline thread_local TraceCost g_traceCost;
+
+#endif
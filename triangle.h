@@ -0,0 +1,203 @@
+#ifndef TRIANGLE_H
+#define TRIANGLE_H
+
+#include "common.h"
+
+#include <algorithm>
+
+// Ray/triangle intersection kernels. Each one stores the triangle in its own precomputed format and
+// reports t and the barycentric coordinates (u for p1, v for p2) of a hit inside [t_min, t_max].
+// The Triangle hittable picks one with TRIANGLE_KERNEL, bench.cpp compares all of them.
+// The constructors are constexpr so baked meshes get their triangles precomputed at compile time.
+
+#define EPSILON 0.000001
+
+// ---------------------------------------------------------------- MollerTrumbore
+
+// Stores the three vertices and derives the edges per test (36 bytes)
+struct MollerTrumbore {
+    vec3 p0, p1, p2;
+
+    constexpr MollerTrumbore() {}
+    constexpr MollerTrumbore(vec3 p0, vec3 p1, vec3 p2) : p0(p0), p1(p1), p2(p2) {}
+
+    bool intersect(const Ray& r, float t_min, float t_max, float& t, float& u, float& v) const {
+        vec3 edge1, edge2;
+
+        // the edges that share point_0
+        edge1 = p1-p0;
+        edge2 = p2-p0;
+
+        vec3 pvec = cross(r.direction, edge2);
+        float determinant = dot(edge1, pvec);
+
+        if (determinant > -EPSILON && determinant < EPSILON)
+            return false;
+
+        float inverse_determinant = 1.0 / determinant;
+
+        // U and V are the barycentric UV coordinates on the triangle
+        vec3 tvec = r.origin - p0;
+        u = dot(tvec, pvec) * inverse_determinant;
+        if (u < 0.0 || u > 1.0)
+            return false;
+
+        vec3 qvec = cross(tvec, edge1);
+        v = dot(r.direction, qvec) * inverse_determinant;
+        if (v < 0.0 || u + v > 1.0)
+            return false;
+
+        // t is the distance from the ray origin to the triangle
+        t = dot(edge2, qvec) * inverse_determinant;
+
+        return !(t < t_min || t > t_max);
+    }
+
+    vec3 normal() const {
+        return unitVector(cross(p1-p0, p2-p0));
+    }
+};
+
+// ---------------------------------------------------------------- BaldwinWeber
+
+// Baldwin & Weber 2016, "Fast Ray-Triangle Intersections by Coordinate Transformation".
+// Stores the world -> barycentric transform and the plane. The column of the largest normal component
+// is (0, 0, 1) by construction so only the other two columns are kept (9 floats + axis)
+struct BaldwinWeber {
+    float m[9];
+    signed char axis;        // largest component of the normal, the fixed column
+    signed char normalSign;  // the plane row is divided by n[axis], this restores the winding
+
+    constexpr BaldwinWeber() : m{}, axis(0), normalSign(1) {}
+    constexpr BaldwinWeber(vec3 p0, vec3 p1, vec3 p2) : m{}, axis(0), normalSign(1) {
+        vec3 e1 = p1 - p0;
+        vec3 e2 = p2 - p0;
+        vec3 n = cross(e1, e2);
+
+        vec3 c20 = cross(p2, p0);
+        vec3 c10 = cross(p1, p0);
+        float d = dot(p0, n);
+
+        auto abs = [](float f) { return f < 0 ? -f : f; }; // fabs is not constexpr
+
+        if (abs(n.x) > abs(n.y) && abs(n.x) > abs(n.z)) {
+            axis = 0;
+            float inv = 1.0f / n.x;
+            float rows[9] = {  e2.z*inv, -e2.y*inv,  c20.x*inv,
+                              -e1.z*inv,  e1.y*inv, -c10.x*inv,
+                                n.y*inv,   n.z*inv,     -d*inv };
+            std::copy(rows, rows + 9, m);
+            normalSign = n.x < 0 ? -1 : 1;
+        } else if (abs(n.y) > abs(n.z)) {
+            axis = 1;
+            float inv = 1.0f / n.y;
+            float rows[9] = { -e2.z*inv,  e2.x*inv,  c20.y*inv,
+                               e1.z*inv, -e1.x*inv, -c10.y*inv,
+                                n.x*inv,   n.z*inv,     -d*inv };
+            std::copy(rows, rows + 9, m);
+            normalSign = n.y < 0 ? -1 : 1;
+        } else {
+            axis = 2;
+            float inv = 1.0f / n.z;
+            float rows[9] = {  e2.y*inv, -e2.x*inv,  c20.z*inv,
+                              -e1.y*inv,  e1.x*inv, -c10.z*inv,
+                                n.x*inv,   n.y*inv,     -d*inv };
+            std::copy(rows, rows + 9, m);
+            normalSign = n.z < 0 ? -1 : 1;
+        }
+    }
+
+    bool intersect(const Ray& r, float t_min, float t_max, float& t, float& u, float& v) const {
+        const vec3& o = r.origin;
+        const vec3& d = r.direction;
+
+        // (a, b) are the two free coordinates, f the fixed one
+        float oa, ob, of, da, db, df;
+        switch (axis) {
+            case 0:  oa = o.y; ob = o.z; of = o.x; da = d.y; db = d.z; df = d.x; break;
+            case 1:  oa = o.x; ob = o.z; of = o.y; da = d.x; db = d.z; df = d.y; break;
+            default: oa = o.x; ob = o.y; of = o.z; da = d.x; db = d.y; df = d.z; break;
+        }
+
+        // distance to the plane along the ray
+        float dz = df + m[6]*da + m[7]*db;
+        float oz = of + m[6]*oa + m[7]*ob + m[8];
+        t = -oz / dz;
+        if (!(t >= t_min && t <= t_max))
+            return false;
+
+        float pa = oa + t*da;
+        float pb = ob + t*db;
+        u = m[0]*pa + m[1]*pb + m[2];
+        if (u < 0 || u > 1)
+            return false;
+
+        v = m[3]*pa + m[4]*pb + m[5];
+
+        return v >= 0 && u + v <= 1;
+    }
+
+    vec3 normal() const {
+        vec3 n = axis == 0 ? vec3(1, m[6], m[7]) : axis == 1 ? vec3(m[6], 1, m[7]) : vec3(m[6], m[7], 1);
+        return float(normalSign) * unitVector(n);
+    }
+};
+
+// ---------------------------------------------------------------- Woop
+
+// Woop 2004, "A Ray Tracing Hardware Architecture for Dynamic Scenes": the affine transform that maps
+// the triangle onto the unit triangle (0,0,0) (1,0,0) (0,1,0), the normal becomes the z axis (12 floats)
+struct Woop {
+    float m[12];
+
+    constexpr Woop() : m{} {}
+    constexpr Woop(vec3 p0, vec3 p1, vec3 p2) : m{} {
+        vec3 e1 = p1 - p0;
+        vec3 e2 = p2 - p0;
+        vec3 n = cross(e1, e2);
+
+        // inverse of the 3x3 matrix with columns e1, e2, n: its rows are the cross products / det
+        vec3 r0 = cross(e2, n);
+        vec3 r1 = cross(n, e1);
+        vec3 r2 = n;
+        float inv = 1.0f / dot(e1, r0);
+        r0 *= inv;
+        r1 *= inv;
+        r2 *= inv;
+
+        float rows[12] = { r0.x, r0.y, r0.z, -dot(r0, p0),
+                           r1.x, r1.y, r1.z, -dot(r1, p0),
+                           r2.x, r2.y, r2.z, -dot(r2, p0) };
+        std::copy(rows, rows + 12, m);
+    }
+
+    bool intersect(const Ray& r, float t_min, float t_max, float& t, float& u, float& v) const {
+        const vec3& o = r.origin;
+        const vec3& d = r.direction;
+
+        // in unit triangle space the triangle lies in the z = 0 plane
+        float oz = m[8]*o.x + m[9]*o.y + m[10]*o.z + m[11];
+        float dz = m[8]*d.x + m[9]*d.y + m[10]*d.z;
+        t = -oz / dz;
+        if (!(t >= t_min && t <= t_max))
+            return false;
+
+        float ox = m[0]*o.x + m[1]*o.y + m[2]*o.z + m[3];
+        float dx = m[0]*d.x + m[1]*d.y + m[2]*d.z;
+        u = ox + t*dx;
+        if (u < 0 || u > 1)
+            return false;
+
+        float oy = m[4]*o.x + m[5]*o.y + m[6]*o.z + m[7];
+        float dy = m[4]*d.x + m[5]*d.y + m[6]*d.z;
+        v = oy + t*dy;
+
+        return v >= 0 && u + v <= 1;
+    }
+
+    vec3 normal() const {
+        return unitVector(vec3(m[8], m[9], m[10]));
+    }
+};
+
+#endif
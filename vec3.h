@@ -12,30 +12,30 @@ public:
     union { float y, g; };
     union { float z, b; };
 
-    vec3() : x(0), y(0), z(0) {}
-    vec3(const vec3& v) : x(v.x), y(v.y), z(v.z) {}
-    vec3(float e) : x(e), y(e), z(e) {}
-    vec3(float e0, float e1, float e2) : x(e0), y(e1),z(e2) {}
+    constexpr vec3() : x(0), y(0), z(0) {}
+    constexpr vec3(const vec3& v) : x(v.x), y(v.y), z(v.z) {}
+    constexpr vec3(float e) : x(e), y(e), z(e) {}
+    constexpr vec3(float e0, float e1, float e2) : x(e0), y(e1),z(e2) {}
 
-    vec3 operator-() const { return vec3(-x, -y, -z); }
+    constexpr vec3 operator-() const { return vec3(-x, -y, -z); }
     // float operator[](int i) const { return e[i]; } // ff koekeloeren hoe glm dit doet als dit nodig is
     // float& operator[](int i) { return e[i]; }
 
-    vec3& operator+=(const vec3 &v) {
+    constexpr vec3& operator+=(const vec3 &v) {
         x += v.x;
         y += v.y;
         z += v.z;
         return *this;
     }
 
-    vec3& operator*=(const float t) {
+    constexpr vec3& operator*=(const float t) {
         x *= t;
         y *= t;
         z *= t;
         return *this;
     }
 
-    vec3& operator/=(const float t) {
+    constexpr vec3& operator/=(const float t) {
         return *this *= 1/t;
     }
 
@@ -43,7 +43,7 @@ public:
         return sqrt(length_squared());
     }
 
-    float length_squared() const {
+    constexpr float length_squared() const {
         return x*x + y*y + z*z;
     }
 
@@ -63,43 +63,43 @@ inline std::ostream& operator<<(std::ostream &out, const vec3 &v) {
     return out << v.x << ' ' << v.y << ' ' << v.z;
 }
 
-inline vec3 operator+(const vec3 &u, const vec3 &v) {
+constexpr vec3 operator+(const vec3 &u, const vec3 &v) {
     return vec3(u.x + v.x, u.y + v.y, u.z + v.z);
 }
 
-inline vec3 operator-(const vec3 &u, const vec3 &v) {
+constexpr vec3 operator-(const vec3 &u, const vec3 &v) {
     return vec3(u.x - v.x, u.y - v.y, u.z - v.z);
 }
 
-inline vec3 operator*(const vec3 &u, const vec3 &v) {
+constexpr vec3 operator*(const vec3 &u, const vec3 &v) {
     return vec3(u.x * v.x, u.y * v.y, u.z * v.z);
 }
 
-inline vec3 operator*(float t, const vec3 &v) {
+constexpr vec3 operator*(float t, const vec3 &v) {
     return vec3(t*v.x, t*v.y, t*v.z);
 }
 
-inline vec3 operator*(const vec3 &v, float t) {
+constexpr vec3 operator*(const vec3 &v, float t) {
     return t * v;
 }
 
-inline vec3 operator/(vec3 v, float t) {
+constexpr vec3 operator/(vec3 v, float t) {
     return (1/t) * v;
 }
 
-inline float dot(const vec3 &u, const vec3 &v) {
+constexpr float dot(const vec3 &u, const vec3 &v) {
     return u.x * v.x
          + u.y * v.y
          + u.z * v.z;
 }
 
-inline vec3 cross(const vec3 &u, const vec3 &v) {
+constexpr vec3 cross(const vec3 &u, const vec3 &v) {
     return vec3(u.y * v.z - u.z * v.y,
                 u.z * v.x - u.x * v.z,
                 u.x * v.y - u.y * v.x);
 }
 
-inline vec3 reflect(const vec3& v, const vec3& n) {
+constexpr vec3 reflect(const vec3& v, const vec3& n) {
     return v - 2*dot(v,n)*n;
 }
 
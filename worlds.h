@@ -0,0 +1,68 @@
+#ifndef WORLDS_H
+#define WORLDS_H
+
+#include "common.h"
+#include "hittable.h"
+#include "material.h"
+
+// The levels of the game, everything is allocated from the arena of the scene
+
+inline HittableList* world1(Arena& arena) {
+    auto world = arena.make<HittableList>();
+
+    auto matEend1 = arena.make<Metal>(vec3(1.0, 1.0, 0.0), 0.8);
+    auto matEend2 = arena.make<Metal>(vec3(1.0, 0.5, 0.0), 0.8);
+    world->add(arena.make<RotateZ>(arena.make<BadEend>(matEend1, matEend2), 55.0f));
+
+    return world;
+}
+
+inline HittableList* world2(Arena& arena) {
+    auto world = arena.make<HittableList>();
+
+    auto spheres = arena.make<SphereSet>();
+
+    auto ground_material = arena.make<Unlit>(color(0.5, 0.5, 0.5));
+    spheres->add(vec3(0,-1000,0), 1000, ground_material);
+
+    auto material1 = arena.make<Light>(vec3(4.0, 4.0, 4.0));
+    for (int i = -10; i <10; i++) {
+        spheres->add(vec3(-2,i,0), 1.0, material1);
+    }
+    world->add(spheres);
+
+    auto matEend1 = arena.make<Lambertian>(vec3(0.0, 0.0, 0.0));
+    auto matEend2 = arena.make<Lambertian>(vec3(0.9, 0.9, 0.9));
+    world->add(arena.make<RotateZ>(arena.make<Translate>(arena.make<BadEend>(matEend1, matEend2), vec3(0,0,1)), 45.0f));
+
+    return world;
+}
+
+inline HittableList* world3(Arena& arena) {
+    auto world = arena.make<HittableList>();
+
+    auto spheres = arena.make<SphereSet>();
+
+    auto ground_material = arena.make<Metal>(vec3(0.4, 0.4, 0.4), 0.1);
+    spheres->add(vec3(0,0,1000.5), 1000, ground_material);
+
+    auto orangeLight = arena.make<Special>(vec3(1.0, 0.95, 0.1 * MATH::random()));
+
+    int i = 0;
+    for (float x = -5.0f; x<=5.0f; x+=0.9999f) {
+        for (float y = -5.0f; y<=5.0f; y+=0.9999f, i++) {
+            auto yellowLight = arena.make<Special>(vec3(1.0, 1.0, 0.1 * MATH::random()));
+            
+            if (i == 101) {
+                world->add(arena.make<Translate>(arena.make<RotateZ>(arena.make<BadEend>(yellowLight, orangeLight), 220.0f), vec3(x * 3.0 - 0.5, y * 3.0 + 0.5, 0)));
+            } else {
+                spheres->add(vec3(x * 3.0 + 0.1 * MATH::random(), y * 3.0 + 0.1 * MATH::random(),0), 1.1, yellowLight);
+            }
+        }
+    }
+    world->add(spheres);
+
+    return world;
+}
+
+#endif